@@ -18,14 +18,17 @@
 #include "ns3/internet-module.h"
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
 
 #include <vector>
 #include "ns3/aggregate_switch_helper.h"
+#include "ns3/aggregation_queue_helper.h"
 #include "ns3/aggregate_switch.h"
 #include "ns3/custom_client_helper.h"
 #include "ns3/custom_client.h"
 #include "ns3/parameter_server_helper.h"
 #include "ns3/parameter_server.h"
+#include "ns3/state_sampler_helper.h"
 
 // Default Network Topology
 //
@@ -50,19 +53,124 @@ NS_LOG_COMPONENT_DEFINE("CustomScript");
 int
 main(int argc, char* argv[])
 {
+    uint32_t gackBatchSize = 1;
+    Time gackDelay = Seconds(0);
+    uint32_t aackBatchSize = 1;
+    Time aackDelay = Seconds(0);
+    uint16_t numShards = 1;
+    uint32_t elements = 0;
+    std::string dataType = "Int32";
+    uint32_t topK = 0;
+    std::string statsJson = "";
+    std::string statsCsv = "";
+    std::string stateFile = "";
+    Time stateInterval = MilliSeconds(10);
+    std::string eventTrace = "";
+    bool verbose = true;
+    std::string gradientTrace = "";
+    uint32_t maxPackets = 2;
+    std::string model = "";
+    uint32_t iterations = 1;
+    Time pipelineLatency = Seconds(0);
+    uint32_t elementsPerPass = 0;
+    std::string portRate = "0bps";
+    uint64_t switchMemory = 0;
+    uint32_t pipelineStages = 1;
+    uint32_t resultCache = 0;
+    std::string slotIndex = "Associative";
+    std::string collisionPolicy = "Forward";
+    uint32_t probeLimit = 4;
+    bool preemption = false;
+    std::string progressTos = "";
+    double pacing = 0;
+    uint16_t quorum = 0;
+    std::string latePolicy = "Drop";
+    bool elastic = false;
+    Time joinAt = Seconds(1.0);
+    Time leaveAt = Seconds(10.0);
+    bool prio = false;
+    double redMinTh = 0;
+    double redMaxTh = 15;
+    bool ecn = false;
+    std::string queueSize = "100p";
+    std::string queueTrace = "";
+    Time preemptIdleTime = MilliSeconds(10);
+    Time aackTimeout = Seconds(0);
+
     CommandLine cmd(__FILE__);
+    cmd.AddValue("gackBatchSize", "Gradients acknowledged per cumulative GACK", gackBatchSize);
+    cmd.AddValue("gackDelay", "Max time a partial GACK batch is held, required with gackBatchSize above 1", gackDelay);
+    cmd.AddValue("aackBatchSize", "Completed gradients acknowledged per AACK", aackBatchSize);
+    cmd.AddValue("aackDelay", "Max time a partial AACK batch is held, required with aackBatchSize above 1", aackDelay);
+    cmd.AddValue("numShards", "Number of PS shards the job is partitioned over", numShards);
+    cmd.AddValue("elements", "Gradient values carried per packet", elements);
+    cmd.AddValue("dataType", "Element type of the gradient values (Int32, Float32, Float16, BFloat16)", dataType);
+    cmd.AddValue("topK", "Largest magnitude values sent per packet out of elements (0 is dense)", topK);
+    cmd.AddValue("statsJson", "File the per job metrics are written to as JSON", statsJson);
+    cmd.AddValue("statsCsv", "File the per job metrics are written to as CSV", statsCsv);
+    cmd.AddValue("stateFile", "File the window and slot occupancy time series is written to", stateFile);
+    cmd.AddValue("stateInterval", "Time between two rows of the time series", stateInterval);
+    cmd.AddValue("eventTrace", "File the binary event records are written to", eventTrace);
+    cmd.AddValue("verbose", "Log every packet of the applications", verbose);
+    cmd.AddValue("gradientTrace", "Gradient emission trace the workers replay (PartId is the worker id)", gradientTrace);
+    cmd.AddValue("maxPackets", "Gradients sent per worker", maxPackets);
+    cmd.AddValue("model", "Model profile the workers train (ResNet-50, VGG-16, BERT-Base, GPT-2), it sets the gradients sent", model);
+    cmd.AddValue("iterations", "Training iterations of the model profile", iterations);
+    cmd.AddValue("pipelineLatency", "Time one pass through the switch pipeline takes", pipelineLatency);
+    cmd.AddValue("elementsPerPass", "Elements the switch aggregates per pass, more recirculate (0 is unlimited)", elementsPerPass);
+    cmd.AddValue("portRate", "Switch processing rate per ingress port (0bps is unlimited)", portRate);
+    cmd.AddValue("switchMemory", "Switch aggregator memory in bytes (0 keeps the 10 slot buffer)", switchMemory);
+    cmd.AddValue("pipelineStages", "Pipeline stages the switch memory is split across", pipelineStages);
+    cmd.AddValue("slotIndex", "How the switch maps gradients to slots (Associative, Hash)", slotIndex);
+    cmd.AddValue("collisionPolicy", "Hash collision handling of the switch (Forward, LinearProbe, MultiHash)", collisionPolicy);
+    cmd.AddValue("probeLimit", "Candidate slots a LinearProbe or MultiHash lookup tries", probeLimit);
+    cmd.AddValue("preemption", "Let the switch take slots from stalled or lower progress jobs", preemption);
+    cmd.AddValue("preemptIdleTime", "Time without gradients after which any job can take the slots of a job", preemptIdleTime);
+    cmd.AddValue("progressTos", "Worker TOS per progress class, lagging first (e.g. 16,0,8 for the PrioQueueDisc bands 0,1,2)", progressTos);
+    cmd.AddValue("pacing", "Share of the link rate workers pace their gradients at (0 disables pacing)", pacing);
+    cmd.AddValue("quorum", "Parts a gradient completes with at the switch and the PS (0 waits for every part)", quorum);
+    cmd.AddValue("latePolicy", "What happens to parts arriving after a quorum (Drop, Fold)", latePolicy);
+    cmd.AddValue("elastic", "Let workers join and leave the job through the switch", elastic);
+    cmd.AddValue("joinAt", "Time the third worker starts, with elastic and a time after 1s it joins at the seq the job has reached", joinAt);
+    cmd.AddValue("leaveAt", "Time the third worker stops and leaves the job", leaveAt);
+    cmd.AddValue("prio", "Install a 3 band PrioQueueDisc on the bottleneck, the band follows the TOS", prio);
+    cmd.AddValue("redMinTh", "RED minimum threshold in packets of the bottleneck queues (0 keeps FIFO queues)", redMinTh);
+    cmd.AddValue("redMaxTh", "RED maximum threshold in packets of the bottleneck queues", redMaxTh);
+    cmd.AddValue("ecn", "Let RED mark ECN capable packets instead of dropping them", ecn);
+    cmd.AddValue("queueSize", "Capacity of every bottleneck queue", queueSize);
+    cmd.AddValue("queueTrace", "File the drops and marks of the bottleneck queues are written to", queueTrace);
+    cmd.AddValue("resultCache", "Completed results the switch keeps until their AACK (0 disables the cache)", resultCache);
+    cmd.AddValue("aackTimeout", "Time without AACK progress before workers resend GACKed gradients (0 disables it)", aackTimeout);
     cmd.Parse(argc, argv);
 
+    Config::SetDefault("ns3::CustomClient::Elements", UintegerValue(elements));
+    Config::SetDefault("ns3::CustomClient::DataType", StringValue(dataType));
+    Config::SetDefault("ns3::CustomClient::TopK", UintegerValue(topK));
+    Config::SetDefault("ns3::CustomClient::Model", StringValue(model));
+    Config::SetDefault("ns3::CustomClient::Iterations", UintegerValue(iterations));
+    Config::SetDefault("ns3::CustomClient::AackTimeout", TimeValue(aackTimeout));
+    Config::SetDefault("ns3::CustomClient::ProgressTos", StringValue(progressTos));
+    Config::SetDefault("ns3::CustomClient::PacingFraction", DoubleValue(pacing));
+    Config::SetDefault("ns3::CustomClient::Elastic", BooleanValue(elastic));
+    Config::SetDefault("ns3::AggregateSwitch::DataType", StringValue(dataType));
+    Config::SetDefault("ns3::AggregateSwitch::Quorum", UintegerValue(quorum));
+    Config::SetDefault("ns3::AggregateSwitch::LatePolicy", StringValue(latePolicy));
+    Config::SetDefault("ns3::ParameterServer::Quorum", UintegerValue(quorum));
+    Config::SetDefault("ns3::ParameterServer::LatePolicy", StringValue(latePolicy));
+    Config::SetDefault("ns3::ParameterServer::DataType", StringValue(dataType));
+
     Time::SetResolution(Time::NS);
-    LogComponentEnable("CustomClientApplication", LOG_LEVEL_INFO);
-    LogComponentEnable("AggregateSwitchApplication", LOG_LEVEL_INFO);
-    LogComponentEnable ("ParameterServerApplication", LOG_LEVEL_INFO);
+    if (verbose) {
+        LogComponentEnable("CustomClientApplication", LOG_LEVEL_INFO);
+        LogComponentEnable("AggregateSwitchApplication", LOG_LEVEL_INFO);
+        LogComponentEnable ("ParameterServerApplication", LOG_LEVEL_INFO);
+    }
 
     // Nodes
     NodeContainer leftWingNodes;
     leftWingNodes.Create(3);
     NodeContainer rightWingNodes;
-    rightWingNodes.Create(1);
+    rightWingNodes.Create(numShards);
     NodeContainer bottleneckNodes;
     bottleneckNodes.Create(2);
 
@@ -95,9 +203,11 @@ main(int argc, char* argv[])
     leftSwitchDevices.Add(cl3.Get(1));
     
     // Install ptp links for right wing and right switch
-    NetDeviceContainer cr1 = ptp1.Install(rightWingNodes.Get(0), bottleneckNodes.Get(1));
-    rightWingDevices.Add(cr1.Get(0));
-    rightSwitchDevices.Add(cr1.Get(1));
+    for (uint32_t i = 0; i < rightWingNodes.GetN(); ++i) {
+        NetDeviceContainer cr = ptp1.Install(rightWingNodes.Get(i), bottleneckNodes.Get(1));
+        rightWingDevices.Add(cr.Get(0));
+        rightSwitchDevices.Add(cr.Get(1));
+    }
 
     // Install ptp link for bottleneck
     bottleneckDevices.Add(ptp2.Install(bottleneckNodes.Get(0), bottleneckNodes.Get(1)));
@@ -108,6 +218,24 @@ main(int argc, char* argv[])
     stack.Install(rightWingNodes);
     stack.Install(bottleneckNodes);
 
+    // Bottleneck queue discs, the workers incast through them to the aggregation switch.
+    // Installed before the addresses, which would add the default queue disc otherwise.
+    QueueDiscContainer bottleneckQueues;
+    if (prio || redMinTh > 0 || !queueTrace.empty()) {
+        AggregationQueueHelper queueHelper;
+        queueHelper.SetMaxSize(queueSize);
+        if (prio) {
+            queueHelper.SetPrio(3, "");
+        }
+        if (redMinTh > 0) {
+            queueHelper.SetRed(redMinTh, redMaxTh, ecn);
+        }
+        if (!queueTrace.empty()) {
+            queueHelper.EnableDropTrace(queueTrace);
+        }
+        bottleneckQueues = queueHelper.Install(bottleneckDevices);
+    }
+
     // IPv4 Address
     Ipv4InterfaceContainer leftWingIfc;
     Ipv4InterfaceContainer rightWingIfc;
@@ -151,15 +279,53 @@ main(int argc, char* argv[])
     const Address leftSwitchAddr = bottleneckIfc.GetAddress(0);
     const Address rightSwitchAddr = bottleneckIfc.GetAddress(1);
 
+    // Metrics shared by the switch and the workers, written at Simulator::Destroy
+    Ptr<JobStats> stats = CreateObject<JobStats>();
+    stats->SetAttribute("JsonFile", StringValue(statsJson));
+    stats->SetAttribute("CsvFile", StringValue(statsCsv));
+
+    // Binary event log, read back with event_trace_reader
+    Ptr<EventTrace> events;
+    if (!eventTrace.empty()) {
+        events = CreateObject<EventTrace>();
+        events->SetAttribute("FileName", StringValue(eventTrace));
+    }
+
+    // Recorded gradient emissions replace the fixed send interval of the workers
+    Ptr<GradientTrace> replay;
+    if (!gradientTrace.empty()) {
+        replay = CreateObject<GradientTrace>();
+        replay->SetAttribute("FileName", StringValue(gradientTrace));
+    }
+
     // Port numbers
     uint16_t inPort = 9;
 
     // Right INA Switch
-    uint16_t maxParts = 3;
+    // A late elastic worker is not part of the static fan-in, it joins at the seq the job has reached
+    uint16_t maxParts = (elastic && joinAt > Seconds(1.0)) ? 2 : 3;
     AggregateSwitchHelper aggregateSwitch(inPort, rightWingIfc.GetAddress(0), inPort); // params : open port, dst address, dst port
     aggregateSwitch.SetAttribute("MaxParts", UintegerValue(maxParts));
+    aggregateSwitch.SetAttribute("GackBatchSize", UintegerValue(gackBatchSize));
+    aggregateSwitch.SetAttribute("GackDelay", TimeValue(gackDelay));
+    aggregateSwitch.SetAttribute("PipelineLatency", TimeValue(pipelineLatency));
+    aggregateSwitch.SetAttribute("ElementsPerPass", UintegerValue(elementsPerPass));
+    aggregateSwitch.SetAttribute("PortProcessingRate", StringValue(portRate));
+    aggregateSwitch.SetAttribute("MemoryBytes", UintegerValue(switchMemory));
+    aggregateSwitch.SetAttribute("PipelineStages", UintegerValue(pipelineStages));
+    aggregateSwitch.SetAttribute("ResultCacheSize", UintegerValue(resultCache));
+    aggregateSwitch.SetAttribute("SlotIndex", StringValue(slotIndex));
+    aggregateSwitch.SetAttribute("CollisionPolicy", StringValue(collisionPolicy));
+    aggregateSwitch.SetAttribute("ProbeLimit", UintegerValue(probeLimit));
+    aggregateSwitch.SetAttribute("Preemption", BooleanValue(preemption));
+    aggregateSwitch.SetAttribute("PreemptIdleTime", TimeValue(preemptIdleTime));
+    aggregateSwitch.SetStats(stats);
+    aggregateSwitch.SetAttribute("EventTrace", PointerValue(events));
 
     ApplicationContainer switchApp = aggregateSwitch.Install(bottleneckNodes.Get(1)); // Install right switch
+    for (uint32_t i = 0; i < rightWingNodes.GetN(); ++i) {
+        aggregateSwitch.AddParameterServer(switchApp.Get(0), rightWingIfc.GetAddress(i), inPort);
+    }
     switchApp.Start(Seconds(0.0));
     switchApp.Stop(Seconds(10.0));
 
@@ -167,11 +333,14 @@ main(int argc, char* argv[])
     uint16_t workerID = 0;
     CustomClientHelper cc0(rightSwitchAddr, inPort); // params : dst address, dst port
     cc0.SetAttribute("Port", UintegerValue(inPort));
-    cc0.SetAttribute("MaxPackets", UintegerValue(2));
+    cc0.SetAttribute("MaxPackets", UintegerValue(maxPackets));
     cc0.SetAttribute("Interval", TimeValue(Seconds(1.0)));
     cc0.SetAttribute("PacketSize", UintegerValue(1024));
     cc0.SetAttribute("JobId", UintegerValue(1));
     cc0.SetAttribute("PartId", UintegerValue(0));
+    cc0.SetStats(stats);
+    cc0.SetAttribute("EventTrace", PointerValue(events));
+    cc0.SetAttribute("GradientTrace", PointerValue(replay));
 
     ApplicationContainer cApp0 = cc0.Install(leftWingNodes.Get(workerID));
     cApp0.Start(Seconds(1.0));
@@ -181,11 +350,14 @@ main(int argc, char* argv[])
     workerID = 1;
     CustomClientHelper cc1(rightSwitchAddr, inPort); // params : dst address, dst port
     cc1.SetAttribute("Port", UintegerValue(inPort));
-    cc1.SetAttribute("MaxPackets", UintegerValue(2));
+    cc1.SetAttribute("MaxPackets", UintegerValue(maxPackets));
     cc1.SetAttribute("Interval", TimeValue(Seconds(1.5)));
     cc1.SetAttribute("PacketSize", UintegerValue(1024));
     cc1.SetAttribute("JobId", UintegerValue(1));
     cc1.SetAttribute("PartId", UintegerValue(1));
+    cc1.SetStats(stats);
+    cc1.SetAttribute("EventTrace", PointerValue(events));
+    cc1.SetAttribute("GradientTrace", PointerValue(replay));
 
     ApplicationContainer cApp1 = cc1.Install(leftWingNodes.Get(workerID));
     cApp1.Start(Seconds(1.0));
@@ -195,25 +367,53 @@ main(int argc, char* argv[])
     workerID = 2;
     CustomClientHelper cc2(rightSwitchAddr, inPort); // params : dst address, dst port
     cc2.SetAttribute("Port", UintegerValue(inPort));
-    cc2.SetAttribute("MaxPackets", UintegerValue(2));
+    cc2.SetAttribute("MaxPackets", UintegerValue(maxPackets));
     cc2.SetAttribute("Interval", TimeValue(Seconds(1.5)));
     cc2.SetAttribute("PacketSize", UintegerValue(1024));
     cc2.SetAttribute("JobId", UintegerValue(1));
     cc2.SetAttribute("PartId", UintegerValue(2));
+    cc2.SetStats(stats);
+    cc2.SetAttribute("EventTrace", PointerValue(events));
+    cc2.SetAttribute("GradientTrace", PointerValue(replay));
 
     ApplicationContainer cApp2 = cc2.Install(leftWingNodes.Get(workerID));
-    cApp2.Start(Seconds(1.0));
-    cApp2.Stop(Seconds(10.0));
-
-    // PS Job 1
-    uint16_t psID = 0;
-    ParameterServerHelper ps0(inPort); // open port
-    ps0.SetAttribute("MaxPackets", UintegerValue(0));
-    ps0.SetAttribute("RemotePort", UintegerValue(inPort));
-
-    ApplicationContainer psApp0 = ps0.Install(rightWingNodes.Get(psID));
-    psApp0.Start(Seconds(0.0));
-    psApp0.Stop(Seconds(10.0));
+    cApp2.Start(joinAt);
+    cApp2.Stop(leaveAt);
+    if (!elastic && leaveAt < Seconds(10.0)) {
+        // A static worker cannot LEAVE, the control plane removes it as after a failure
+        Simulator::Schedule(leaveAt, &AggregateSwitch::RemoveMember, switchApp.Get(0)->GetObject<AggregateSwitch>(),
+                            1, 2);
+    }
+
+    // PS Job 1, one shard per right wing node
+    for (uint16_t psID = 0; psID < numShards; ++psID) {
+        ParameterServerHelper ps(inPort); // open port
+        ps.SetAttribute("MaxPackets", UintegerValue(0));
+        ps.SetAttribute("RemotePort", UintegerValue(inPort));
+        ps.SetAttribute("MaxParts", UintegerValue(maxParts));
+        ps.SetAttribute("AackBatchSize", UintegerValue(aackBatchSize));
+        ps.SetAttribute("AackDelay", TimeValue(aackDelay));
+        ps.SetAttribute("ShardId", UintegerValue(psID));
+        ps.SetAttribute("NumShards", UintegerValue(numShards));
+        ps.SetAttribute("EventTrace", PointerValue(events));
+
+        ApplicationContainer psApp = ps.Install(rightWingNodes.Get(psID));
+        psApp.Start(Seconds(0.0));
+        psApp.Stop(Seconds(10.0));
+    }
+
+    // Window and slot occupancy time series, the helper keeps the sampler alive
+    StateSamplerHelper sampler(stateFile, stateInterval);
+    if (!stateFile.empty()) {
+        sampler.Install(switchApp);
+        sampler.Install(cApp0);
+        sampler.Install(cApp1);
+        sampler.Install(cApp2);
+        for (uint32_t i = 0; i < bottleneckQueues.GetN(); ++i) {
+            sampler.Install(bottleneckQueues.Get(i), "bottleneck" + std::to_string(i));
+        }
+        sampler.Start(Seconds(0.0), Seconds(10.0));
+    }
 
     // Routing
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
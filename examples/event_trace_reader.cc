@@ -0,0 +1,153 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/event_trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Reads a binary event trace written by EventTrace, converts it to CSV
+// and / or prints a per job summary.
+//
+//  ./ns3 run "event_trace_reader --input=events.bin --csv=events.csv --summary"
+
+using namespace ns3;
+
+/// Per job totals of the summary
+struct JobSummary
+{
+    uint64_t counts[EVENT_TYPE_COUNT] = {}; //!< Records per event type
+    int64_t firstSend = -1;                 //!< First WORKER_SEND in ns
+    int64_t lastAack = -1;                  //!< Last WORKER_AACK in ns
+};
+
+int
+main(int argc, char* argv[])
+{
+    std::string input = "events.bin";
+    std::string csv = "";
+    bool summary = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Binary event trace to read", input);
+    cmd.AddValue("csv", "CSV file to convert the records to (- for stdout)", csv);
+    cmd.AddValue("summary", "Print per event type and per job totals", summary);
+    cmd.Parse(argc, argv);
+
+    std::ifstream in(input, std::ios::in | std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << input << std::endl;
+        return 1;
+    }
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t recordSize = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&recordSize), sizeof(recordSize));
+    if (!in || std::memcmp(magic, "PAEV", 4) != 0 || version != EventTrace::VERSION ||
+        recordSize != sizeof(EventRecord))
+    {
+        std::cerr << input << " is not a version " << EventTrace::VERSION << " event trace" << std::endl;
+        return 1;
+    }
+
+    std::ofstream csvFile;
+    std::ostream* out = nullptr;
+    if (csv == "-")
+    {
+        out = &std::cout;
+    }
+    else if (!csv.empty())
+    {
+        csvFile.open(csv);
+        out = &csvFile;
+    }
+    if (out)
+    {
+        *out << "time_ns,node,type,job,seq,size\n";
+    }
+
+    uint64_t total = 0;
+    int64_t firstTime = 0;
+    int64_t lastTime = 0;
+    std::map<uint16_t, JobSummary> jobs;
+
+    // Stream the records in blocks so traces larger than memory can be read
+    std::vector<EventRecord> block(65536);
+    while (in)
+    {
+        in.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(EventRecord));
+        size_t count = in.gcount() / sizeof(EventRecord);
+        for (size_t i = 0; i < count; i++)
+        {
+            const EventRecord& record = block[i];
+            if (out)
+            {
+                *out << record.time << ',' << record.node << ',' << GetEventTypeName(record.type) << ','
+                     << record.jobId << ',' << record.seq << ',' << record.size << '\n';
+            }
+            if (total == 0)
+            {
+                firstTime = record.time;
+            }
+            lastTime = record.time;
+            total++;
+            if (!summary || record.type >= EVENT_TYPE_COUNT)
+            {
+                continue;
+            }
+            JobSummary& job = jobs[record.jobId];
+            job.counts[record.type]++;
+            if (record.type == EVENT_WORKER_SEND && job.firstSend < 0)
+            {
+                job.firstSend = record.time;
+            }
+            if (record.type == EVENT_WORKER_AACK)
+            {
+                job.lastAack = record.time;
+            }
+        }
+    }
+
+    if (summary)
+    {
+        std::cout << total << " records from " << firstTime / 1e9 << " s to " << lastTime / 1e9 << " s"
+                  << std::endl;
+        for (const auto& entry : jobs)
+        {
+            const JobSummary& job = entry.second;
+            std::cout << "job " << entry.first;
+            if (job.firstSend >= 0 && job.lastAack >= job.firstSend)
+            {
+                std::cout << " jct " << (job.lastAack - job.firstSend) / 1e9 << " s";
+            }
+            std::cout << std::endl;
+            for (uint8_t type = 0; type < EVENT_TYPE_COUNT; type++)
+            {
+                if (job.counts[type])
+                {
+                    std::cout << "  " << GetEventTypeName(type) << ' ' << job.counts[type] << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/gradient_trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Converts a CSV gradient emission log, one "time_ns,job,worker,tensor,bytes"
+// line per emission sorted by time, into the binary trace GradientTrace maps.
+// Lines starting with a non digit (headers, comments) are skipped.
+//
+//  ./ns3 run "gradient_trace_writer --input=emissions.csv --output=emissions.bin"
+
+using namespace ns3;
+
+int
+main(int argc, char* argv[])
+{
+    std::string input = "emissions.csv";
+    std::string output = "emissions.bin";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "CSV emission log to convert", input);
+    cmd.AddValue("output", "Binary gradient trace to write", output);
+    cmd.Parse(argc, argv);
+
+    std::ifstream in(input);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << input << std::endl;
+        return 1;
+    }
+    std::ofstream out(output, std::ios::out | std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Cannot open " << output << std::endl;
+        return 1;
+    }
+    uint32_t version = GradientTrace::VERSION;
+    uint32_t recordSize = sizeof(GradientTraceRecord);
+    out.write("PAGT", 4);
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&recordSize), sizeof(recordSize));
+
+    std::string line;
+    uint64_t count = 0;
+    int64_t lastTime = 0;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] < '0' || line[0] > '9')
+        {
+            continue;
+        }
+        std::stringstream ss(line);
+        GradientTraceRecord record;
+        char comma;
+        ss >> record.time >> comma >> record.jobId >> comma >> record.workerId >> comma >> record.tensor >>
+            comma >> record.bytes;
+        if (!ss)
+        {
+            std::cerr << "Skipping malformed line : " << line << std::endl;
+            continue;
+        }
+        if (record.time < lastTime)
+        {
+            std::cerr << "Records must be sorted by time, line : " << line << std::endl;
+            return 1;
+        }
+        lastTime = record.time;
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        count++;
+    }
+    std::cout << "Wrote " << count << " records to " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "ns3/aggregate_switch_helper.h"
+#include "ns3/aggregate_switch.h"
+#include "ns3/custom_client_helper.h"
+#include "ns3/custom_client.h"
+#include "ns3/job_stats.h"
+#include "ns3/parameter_server_helper.h"
+#include "ns3/parameter_server.h"
+#include "ns3/ring_allreduce_helper.h"
+
+// Runs the same job on the same topology with each protocol and reports
+// the JCT and goodput of PS, ATP, PA-ATP, SwitchML and a host based ring
+// all-reduce relative to the plain PS. The ring runs over TCP through the switch node,
+// which only routes in that run.
+//
+// Workers send back to back by default, limited by their window like the ring
+// is by TCP. The interval only paces the PS, ATP, PA-ATP and SwitchML workers,
+// it does not apply to the ring run, so a non zero one skews the comparison.
+//
+// Star Topology
+//
+//  w0 ---
+//       |
+//  w1 -- s -- ps
+//       |
+//  wN ---
+//
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("ProtocolComparison");
+
+/// Job and topology shared by every run
+struct Scenario
+{
+    uint16_t workers;       //!< Workers of the job
+    uint32_t maxPackets;    //!< Gradients per worker
+    uint32_t packetSize;    //!< Gradient packet size
+    Time interval;          //!< Time between gradients (zero sends back to back, unused by the ring)
+    std::string model;      //!< Model profile (empty sends MaxPackets gradients)
+    uint32_t iterations;    //!< Iterations of the model profile
+    std::string dataRate;   //!< Link rate
+    std::string delay;      //!< Link delay
+    Time rto;               //!< Worker retransmission timeout
+    uint32_t slotPool;      //!< Switch slots of the job in SwitchML mode
+    Time stop;              //!< Simulation end
+};
+
+/// JCT and goodput of one run
+struct Result
+{
+    Time jct;        //!< Job completion time
+    double goodput;  //!< Goodput in bits per second
+};
+
+/**
+ * \brief Run the scenario with one protocol.
+ * \param protocol protocol name ( PS, ATP, PA-ATP, SwitchML or Ring )
+ * \param scenario the job and topology
+ * \return the JCT and goodput of the job
+ */
+static Result
+RunScenario(const std::string& protocol, const Scenario& scenario)
+{
+    const uint16_t jobId = 1;
+    const uint16_t port = 9;
+
+    NodeContainer workerNodes;
+    workerNodes.Create(scenario.workers);
+    NodeContainer switchNode;
+    switchNode.Create(1);
+    NodeContainer psNode;
+    psNode.Create(1);
+
+    PointToPointHelper ptp;
+    ptp.SetDeviceAttribute("DataRate", StringValue(scenario.dataRate));
+    ptp.SetChannelAttribute("Delay", StringValue(scenario.delay));
+
+    InternetStackHelper stack;
+    stack.Install(workerNodes);
+    stack.Install(switchNode);
+    stack.Install(psNode);
+
+    Ipv4AddressHelper address;
+    address.SetBase("10.1.1.0", "255.255.255.0");
+    std::vector<Address> workerAddrs;
+    for (uint32_t i = 0; i < workerNodes.GetN(); ++i) {
+        Ipv4InterfaceContainer workerIfc = address.Assign(ptp.Install(workerNodes.Get(i), switchNode.Get(0)));
+        workerAddrs.push_back(workerIfc.GetAddress(0));
+        address.NewNetwork();
+    }
+    Ipv4InterfaceContainer psIfc = address.Assign(ptp.Install(psNode.Get(0), switchNode.Get(0)));
+    const Address psAddr = psIfc.GetAddress(0);
+    const Address switchAddr = psIfc.GetAddress(1);
+
+    Ptr<JobStats> stats = CreateObject<JobStats>();
+
+    if (protocol == "Ring") {
+        RingAllReduceHelper ring(port);
+        ring.SetAttribute("JobId", UintegerValue(jobId));
+        ring.SetAttribute("MaxPackets", UintegerValue(scenario.maxPackets));
+        ring.SetAttribute("PacketSize", UintegerValue(scenario.packetSize));
+        ring.SetAttribute("Model", StringValue(scenario.model));
+        ring.SetAttribute("Iterations", UintegerValue(scenario.iterations));
+        ring.SetStats(stats);
+        ApplicationContainer ringApps = ring.Install(workerNodes, workerAddrs);
+        ringApps.Start(Seconds(1.0));
+        ringApps.Stop(scenario.stop);
+    }
+    else {
+        AggregateSwitchHelper aggregateSwitch(port, psAddr, port);
+        aggregateSwitch.SetAttribute("Protocol", StringValue(protocol));
+        aggregateSwitch.SetAttribute("MaxParts", UintegerValue(scenario.workers));
+        aggregateSwitch.SetAttribute("SlotPoolSize", UintegerValue(scenario.slotPool));
+        aggregateSwitch.SetStats(stats);
+        ApplicationContainer switchApp = aggregateSwitch.Install(switchNode.Get(0));
+        aggregateSwitch.AddParameterServer(switchApp.Get(0), psAddr, port);
+        switchApp.Start(Seconds(0.0));
+        switchApp.Stop(scenario.stop);
+
+        for (uint16_t partId = 0; partId < scenario.workers; ++partId) {
+            CustomClientHelper worker(switchAddr, port);
+            worker.SetAttribute("Protocol", StringValue(protocol));
+            worker.SetAttribute("Port", UintegerValue(port));
+            worker.SetAttribute("MaxPackets", UintegerValue(scenario.maxPackets));
+            worker.SetAttribute("Interval", TimeValue(scenario.interval));
+            worker.SetAttribute("PacketSize", UintegerValue(scenario.packetSize));
+            worker.SetAttribute("RetransmitTimeout", TimeValue(scenario.rto));
+            worker.SetAttribute("SlotPoolSize", UintegerValue(scenario.slotPool));
+            worker.SetAttribute("JobId", UintegerValue(jobId));
+            worker.SetAttribute("PartId", UintegerValue(partId));
+            worker.SetAttribute("Model", StringValue(scenario.model));
+            worker.SetAttribute("Iterations", UintegerValue(scenario.iterations));
+            worker.SetStats(stats);
+            ApplicationContainer workerApp = worker.Install(workerNodes.Get(partId));
+            workerApp.Start(Seconds(1.0));
+            workerApp.Stop(scenario.stop);
+        }
+
+        ParameterServerHelper ps(port);
+        ps.SetAttribute("MaxPackets", UintegerValue(0));
+        ps.SetAttribute("RemotePort", UintegerValue(port));
+        ps.SetAttribute("MaxParts", UintegerValue(scenario.workers));
+        ApplicationContainer psApp = ps.Install(psNode.Get(0));
+        psApp.Start(Seconds(0.0));
+        psApp.Stop(scenario.stop);
+    }
+
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+
+    Simulator::Stop(scenario.stop);
+    Simulator::Run();
+    Result result{stats->GetJobCompletionTime(jobId), stats->GetGoodput(jobId)};
+    Simulator::Destroy();
+    return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+    Scenario scenario{3, 50, 1024, Seconds(0), "", 1, "1Gbps", "10us", MilliSeconds(10), 10, Seconds(20)};
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("workers", "Workers of the job", scenario.workers);
+    cmd.AddValue("maxPackets", "Gradients sent per worker", scenario.maxPackets);
+    cmd.AddValue("packetSize", "Gradient packet size", scenario.packetSize);
+    cmd.AddValue("interval", "Time between gradients of the aggregation workers (not the ring)", scenario.interval);
+    cmd.AddValue("model", "Model profile the workers train (ResNet-50, VGG-16, BERT-Base, GPT-2)", scenario.model);
+    cmd.AddValue("iterations", "Training iterations of the model profile", scenario.iterations);
+    cmd.AddValue("dataRate", "Rate of every link", scenario.dataRate);
+    cmd.AddValue("delay", "Delay of every link", scenario.delay);
+    cmd.AddValue("rto", "Worker retransmission timeout", scenario.rto);
+    cmd.AddValue("slotPool", "Switch slots of the job in SwitchML mode", scenario.slotPool);
+    cmd.AddValue("stop", "Simulation end of each run", scenario.stop);
+    cmd.Parse(argc, argv);
+
+    Time::SetResolution(Time::NS);
+    // One TCP segment per gradient packet keeps the ring on the same packet sizes
+    Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(scenario.packetSize));
+
+    std::vector<std::string> protocols = {"PS", "ATP", "PA-ATP", "SwitchML", "Ring"};
+    std::vector<Result> results;
+    for (const std::string& protocol : protocols) {
+        results.push_back(RunScenario(protocol, scenario));
+    }
+
+    // Deltas are relative to the plain PS baseline
+    const Result& baseline = results[0];
+    std::cout << std::left << std::setw(10) << "protocol" << std::setw(14) << "jct_s" << std::setw(14)
+              << "iteration_ms" << std::setw(16) << "goodput_mbps" << std::setw(14) << "jct_delta"
+              << "goodput_delta" << std::endl;
+    for (size_t i = 0; i < protocols.size(); i++) {
+        const Result& result = results[i];
+        double jctDelta = baseline.jct.IsPositive() ? result.jct.GetSeconds() / baseline.jct.GetSeconds() - 1 : 0;
+        double goodputDelta = baseline.goodput > 0 ? result.goodput / baseline.goodput - 1 : 0;
+        std::cout << std::left << std::setw(10) << protocols[i] << std::setw(14) << result.jct.GetSeconds()
+                  << std::setw(14) << result.jct.GetSeconds() * 1e3 / scenario.iterations << std::setw(16) << result.goodput / 1e6 << std::setw(14)
+                  << (result.jct.IsPositive() ? std::to_string(jctDelta * 100) + "%" : "n/a")
+                  << (result.goodput > 0 ? std::to_string(goodputDelta * 100) + "%" : "n/a") << std::endl;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "aggregate_switch_helper.h"
 
 #include "ns3/aggregate_switch.h"
+#include "ns3/pointer.h"
 #include "ns3/uinteger.h"
 
 namespace ns3
@@ -19,4 +20,28 @@ AggregateSwitchHelper::AggregateSwitchHelper(uint16_t port, const Address& ip, u
     SetAttribute("RemotePort", UintegerValue(dst_port));
 }
 
+void
+AggregateSwitchHelper::AddParameterServer(Ptr<Application> app, const Address& ip, uint16_t port)
+{
+    app->GetObject<AggregateSwitch>()->AddParameterServer(ip, port);
+}
+
+void
+AggregateSwitchHelper::AddMember(Ptr<Application> app, uint16_t jobId, uint16_t partId, uint32_t fromSeq)
+{
+    app->GetObject<AggregateSwitch>()->AddMember(jobId, partId, fromSeq);
+}
+
+void
+AggregateSwitchHelper::RemoveMember(Ptr<Application> app, uint16_t jobId, uint16_t partId)
+{
+    app->GetObject<AggregateSwitch>()->RemoveMember(jobId, partId);
+}
+
+void
+AggregateSwitchHelper::SetStats(Ptr<JobStats> stats)
+{
+    SetAttribute("Stats", PointerValue(stats));
+}
+
 } // namespace ns3
@@ -2,6 +2,7 @@
 #define AGGREGATE_SWITCH_HELPER_H
 
 #include <ns3/application-helper.h>
+#include <ns3/job_stats.h>
 
 #include <stdint.h>
 
@@ -24,6 +25,45 @@ class AggregateSwitchHelper : public ApplicationHelper
      */
     AggregateSwitchHelper(uint16_t port);
     AggregateSwitchHelper(uint16_t port, const Address& ip, uint16_t dst_port);
+
+    /**
+     * Given a pointer to an AggregateSwitch application, add a PS shard the
+     * gradient seq ranges are partitioned over.
+     *
+     * \param app Smart pointer to the application (real type must be AggregateSwitch).
+     * \param ip The IP address of the PS shard
+     * \param port The port of the PS shard
+     */
+    void AddParameterServer(Ptr<Application> app, const Address& ip, uint16_t port);
+
+    /**
+     * Given a pointer to an AggregateSwitch application, add a worker to a job
+     * from the control plane, e.g. to scale up a job whose workers are not Elastic.
+     *
+     * \param app Smart pointer to the application (real type must be AggregateSwitch).
+     * \param jobId The job id
+     * \param partId The part of the worker
+     * \param fromSeq The first seq the worker contributes to
+     */
+    void AddMember(Ptr<Application> app, uint16_t jobId, uint16_t partId, uint32_t fromSeq);
+
+    /**
+     * Given a pointer to an AggregateSwitch application, remove a worker from a
+     * job from the control plane, e.g. after a worker failure.
+     *
+     * \param app Smart pointer to the application (real type must be AggregateSwitch).
+     * \param jobId The job id
+     * \param partId The part of the worker
+     */
+    void RemoveMember(Ptr<Application> app, uint16_t jobId, uint16_t partId);
+
+    /**
+     * Report the gradients the switches installed from now on forward to the
+     * PS to a metrics collector.
+     *
+     * \param stats The metrics collector.
+     */
+    void SetStats(Ptr<JobStats> stats);
 };
 
 
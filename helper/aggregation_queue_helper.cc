@@ -0,0 +1,133 @@
+#include "aggregation_queue_helper.h"
+
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/node.h"
+#include "ns3/queue-disc.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/trace-helper.h"
+#include "ns3/traffic-control-helper.h"
+
+#include <sstream>
+
+namespace ns3
+{
+
+/**
+ * \brief Write one drop or mark to the trace.
+ * \param stream the trace file
+ * \param where node and device of the queue disc
+ * \param event "drop" or "mark"
+ * \param item the dropped or marked packet
+ * \param reason reason given by the queue disc
+ */
+static void
+TraceQueueEvent(Ptr<OutputStreamWrapper> stream,
+                std::string where,
+                std::string event,
+                Ptr<const QueueDiscItem> item,
+                const char* reason)
+{
+    *stream->GetStream() << Simulator::Now().GetSeconds() << ',' << where << ',' << event << ','
+                         << item->GetSize() << ',' << reason << '\n';
+}
+
+AggregationQueueHelper::AggregationQueueHelper()
+    : m_bands(0),
+      m_red(false),
+      m_minTh(5),
+      m_maxTh(15),
+      m_ecn(false),
+      m_maxSize("100p")
+{
+}
+
+void
+AggregationQueueHelper::SetPrio(uint16_t bands, const std::string& priomap)
+{
+    m_bands = bands;
+    m_priomap = priomap;
+}
+
+void
+AggregationQueueHelper::SetRed(double minTh, double maxTh, bool ecn)
+{
+    m_red = true;
+    m_minTh = minTh;
+    m_maxTh = maxTh;
+    m_ecn = ecn;
+}
+
+void
+AggregationQueueHelper::SetMaxSize(const std::string& maxSize)
+{
+    m_maxSize = maxSize;
+}
+
+void
+AggregationQueueHelper::EnableDropTrace(const std::string& fileName)
+{
+    AsciiTraceHelper ascii;
+    m_dropStream = ascii.CreateFileStream(fileName);
+    *m_dropStream->GetStream() << "time_s,node,device,event,bytes,reason\n";
+}
+
+QueueDiscContainer
+AggregationQueueHelper::Install(NetDeviceContainer devices)
+{
+    TrafficControlHelper tch;
+    // The same FIFO or RED queue goes to the root or to every band
+    auto addQueue = [this](auto add) {
+        if (m_red)
+        {
+            add("ns3::RedQueueDisc",
+                "MaxSize", QueueSizeValue(QueueSize(m_maxSize)),
+                "MinTh", DoubleValue(m_minTh),
+                "MaxTh", DoubleValue(m_maxTh),
+                "QW", DoubleValue(1),
+                "UseEcn", BooleanValue(m_ecn),
+                "UseHardDrop", BooleanValue(false));
+        }
+        else
+        {
+            add("ns3::FifoQueueDisc", "MaxSize", QueueSizeValue(QueueSize(m_maxSize)));
+        }
+    };
+    if (m_bands == 0)
+    {
+        addQueue([&tch](const std::string& type, auto&&... args) { tch.SetRootQueueDisc(type, args...); });
+    }
+    else
+    {
+        uint16_t handle = m_priomap.empty()
+                              ? tch.SetRootQueueDisc("ns3::PrioQueueDisc")
+                              : tch.SetRootQueueDisc("ns3::PrioQueueDisc", "Priomap", StringValue(m_priomap));
+        std::vector<uint16_t> classes = tch.AddQueueDiscClasses(handle, m_bands, "ns3::QueueDiscClass");
+        addQueue([&tch, handle, &classes](const std::string& type, auto&&... args) {
+            tch.AddChildQueueDiscs(handle, classes, type, args...);
+        });
+    }
+
+    QueueDiscContainer queues = tch.Install(devices);
+    if (m_dropStream)
+    {
+        // Child queue discs report their drops and marks to the root
+        for (uint32_t i = 0; i < queues.GetN(); i++)
+        {
+            std::stringstream where;
+            where << devices.Get(i)->GetNode()->GetId() << ',' << devices.Get(i)->GetIfIndex();
+            Ptr<QueueDisc> queue = queues.Get(i);
+            for (const char* source : {"DropBeforeEnqueue", "DropAfterDequeue"})
+            {
+                queue->TraceConnectWithoutContext(
+                    source, MakeBoundCallback(&TraceQueueEvent, m_dropStream, where.str(), std::string("drop")));
+            }
+            queue->TraceConnectWithoutContext(
+                "Mark", MakeBoundCallback(&TraceQueueEvent, m_dropStream, where.str(), std::string("mark")));
+        }
+    }
+    return queues;
+}
+
+} // namespace ns3
@@ -0,0 +1,91 @@
+#ifndef AGGREGATION_QUEUE_HELPER_H
+#define AGGREGATION_QUEUE_HELPER_H
+
+#include <ns3/net-device-container.h>
+#include <ns3/output-stream-wrapper.h>
+#include <ns3/queue-disc-container.h>
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Install queue discs tuned for aggregation traffic on the devices
+ *        of a topology.
+ *
+ * Every device gets one queue disc of MaxSize packets, a FIFO or a RED
+ * with SetRed. With SetPrio the root is a PrioQueueDisc whose bands each
+ * hold one of them, the band of a packet follows its TOS through the
+ * priomap, so the ProgressTos of the workers picks it.
+ *
+ * RED follows the instantaneous queue (QW = 1) and thresholds are in
+ * packets, so a gradient incast is marked or dropped as soon as it crosses
+ * MinTh. Only ECN capable packets are marked, set ECT(0) (0x02) in the
+ * worker Tos or ProgressTos.
+ *
+ * Install before the addresses are assigned, Ipv4AddressHelper only adds
+ * its default queue disc to the devices without one.
+ */
+class AggregationQueueHelper
+{
+  public:
+    AggregationQueueHelper();
+
+    /**
+     * Put a PrioQueueDisc at the root of the queue discs installed from now on.
+     *
+     * \param bands number of bands, band 0 is served first
+     * \param priomap band of each of the 16 socket priorities, space
+     *        separated (empty keeps the PrioQueueDisc default)
+     */
+    void SetPrio(uint16_t bands, const std::string& priomap);
+
+    /**
+     * Use RED instead of FIFO queues.
+     *
+     * \param minTh queue length in packets marking starts at
+     * \param maxTh queue length in packets every packet is marked or dropped at
+     * \param ecn whether ECN capable packets are marked instead of dropped
+     */
+    void SetRed(double minTh, double maxTh, bool ecn);
+
+    /**
+     * \param maxSize capacity of every FIFO or RED queue, e.g. "100p"
+     */
+    void SetMaxSize(const std::string& maxSize);
+
+    /**
+     * Log the drops and ECN marks of the queue discs installed from now on.
+     *
+     * Every line is time_s,node,device,event,bytes,reason where event is
+     * "drop" or "mark".
+     *
+     * \param fileName the trace file
+     */
+    void EnableDropTrace(const std::string& fileName);
+
+    /**
+     * Install the configured queue discs.
+     *
+     * \param devices the devices, each gets its own root queue disc
+     * \return the root queue discs, in the order of the devices
+     */
+    QueueDiscContainer Install(NetDeviceContainer devices);
+
+  private:
+    uint16_t m_bands;                      //!< PrioQueueDisc bands (zero installs no PrioQueueDisc)
+    std::string m_priomap;                 //!< Band of each socket priority
+    bool m_red;                            //!< Whether the queues are RED instead of FIFO
+    double m_minTh;                        //!< RED minimum threshold in packets
+    double m_maxTh;                        //!< RED maximum threshold in packets
+    bool m_ecn;                            //!< Whether RED marks instead of dropping
+    std::string m_maxSize;                 //!< Capacity of every FIFO or RED queue
+    Ptr<OutputStreamWrapper> m_dropStream; //!< Drop and mark trace (null disables it)
+};
+
+} // namespace ns3
+
+#endif /* AGGREGATION_QUEUE_HELPER_H */
@@ -1,6 +1,7 @@
 #include "custom_client_helper.h"
 
 #include "ns3/custom_client.h"
+#include "ns3/pointer.h"
 #include "ns3/uinteger.h"
 
 namespace ns3
@@ -40,4 +41,10 @@ CustomClientHelper::SetFill(Ptr<Application> app,
     app->GetObject<CustomClient>()->SetFill(fill, fillLength, dataLength);
 }
 
+void
+CustomClientHelper::SetStats(Ptr<JobStats> stats)
+{
+    SetAttribute("Stats", PointerValue(stats));
+}
+
 } // namespace ns3
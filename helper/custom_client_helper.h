@@ -2,6 +2,7 @@
 #define CUSTOM_CLIENT_HELPER_H
 
 #include <ns3/application-helper.h>
+#include <ns3/job_stats.h>
 
 #include <stdint.h>
 
@@ -83,6 +84,14 @@ class CustomClientHelper : public ApplicationHelper
      * \param dataLength The desired length of the final echo data.
      */
     void SetFill(Ptr<Application> app, uint8_t* fill, uint32_t fillLength, uint32_t dataLength);
+
+    /**
+     * Report the sends, retransmits and AACK latency of the workers installed
+     * from now on to a metrics collector shared by the jobs.
+     *
+     * \param stats The metrics collector.
+     */
+    void SetStats(Ptr<JobStats> stats);
 };
 
 } // namespace ns3
@@ -0,0 +1,38 @@
+#include "ring_allreduce_helper.h"
+
+#include "ns3/abort.h"
+#include "ns3/pointer.h"
+#include "ns3/ring_allreduce.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+
+RingAllReduceHelper::RingAllReduceHelper(uint16_t port)
+    : ApplicationHelper(RingAllReduce::GetTypeId())
+{
+    SetAttribute("Port", UintegerValue(port));
+}
+
+ApplicationContainer
+RingAllReduceHelper::Install(NodeContainer nodes, const std::vector<Address>& addresses)
+{
+    NS_ABORT_MSG_IF(nodes.GetN() != addresses.size(), "One address per ring node is needed");
+    ApplicationContainer apps;
+    for (uint32_t rank = 0; rank < nodes.GetN(); rank++)
+    {
+        SetAttribute("Rank", UintegerValue(rank));
+        SetAttribute("RingSize", UintegerValue(nodes.GetN()));
+        SetAttribute("NextAddress", AddressValue(addresses[(rank + 1) % nodes.GetN()]));
+        apps.Add(Install(nodes.Get(rank)));
+    }
+    return apps;
+}
+
+void
+RingAllReduceHelper::SetStats(Ptr<JobStats> stats)
+{
+    SetAttribute("Stats", PointerValue(stats));
+}
+
+} // namespace ns3
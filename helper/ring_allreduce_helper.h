@@ -0,0 +1,51 @@
+#ifndef RING_ALLREDUCE_HELPER_H
+#define RING_ALLREDUCE_HELPER_H
+
+#include <ns3/application-helper.h>
+#include <ns3/job_stats.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Create the ranks of a ring all-reduce job
+ */
+class RingAllReduceHelper : public ApplicationHelper
+{
+  public:
+    /**
+     * Create RingAllReduceHelper which will make life easier for people trying
+     * to set up host based all-reduce baselines.
+     *
+     * \param port The port every rank listens on for the previous rank
+     */
+    RingAllReduceHelper(uint16_t port);
+
+    using ApplicationHelper::Install;
+
+    /**
+     * Install one rank per node, in ring order. Rank i streams to rank i + 1
+     * and the last rank to rank 0.
+     *
+     * \param nodes The nodes of the ring.
+     * \param addresses The address of every node, in the same order.
+     * \returns The applications, one per rank.
+     */
+    ApplicationContainer Install(NodeContainer nodes, const std::vector<Address>& addresses);
+
+    /**
+     * Report the sends and reduced buckets of the ranks installed from now on
+     * to a metrics collector shared by the jobs.
+     *
+     * \param stats The metrics collector.
+     */
+    void SetStats(Ptr<JobStats> stats);
+};
+
+} // namespace ns3
+
+#endif /* RING_ALLREDUCE_HELPER_H */
@@ -0,0 +1,89 @@
+#include "state_sampler_helper.h"
+
+#include "ns3/aggregate_switch.h"
+#include "ns3/custom_client.h"
+#include "ns3/node.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <sstream>
+
+namespace ns3
+{
+
+StateSamplerHelper::StateSamplerHelper(const std::string& fileName, Time interval)
+{
+    m_factory.SetTypeId(StateSampler::GetTypeId());
+    m_factory.Set("FileName", StringValue(fileName));
+    m_factory.Set("Interval", TimeValue(interval));
+}
+
+void
+StateSamplerHelper::SetAttribute(std::string name, const AttributeValue& value)
+{
+    m_factory.Set(name, value);
+}
+
+Ptr<StateSampler>
+StateSamplerHelper::GetSampler()
+{
+    if (!m_sampler)
+    {
+        m_sampler = m_factory.Create<StateSampler>();
+    }
+    return m_sampler;
+}
+
+void
+StateSamplerHelper::Install(Ptr<Application> app)
+{
+    Ptr<StateSampler> sampler = GetSampler();
+    if (Ptr<CustomClient> worker = app->GetObject<CustomClient>())
+    {
+        // CSV friendly column prefix : worker<jobId>.<partId>
+        UintegerValue jobId;
+        UintegerValue partId;
+        worker->GetAttribute("JobId", jobId);
+        worker->GetAttribute("PartId", partId);
+        std::stringstream prefix;
+        prefix << "worker" << jobId.Get() << '.' << partId.Get() << '/';
+        for (const char* source : {"CongestionWindow", "AggregationWindow", "LastGack", "LastAack"})
+        {
+            sampler->AddColumn(prefix.str() + source, worker, source);
+        }
+    }
+    else if (Ptr<AggregateSwitch> aggregateSwitch = app->GetObject<AggregateSwitch>())
+    {
+        std::stringstream prefix;
+        prefix << "switch" << app->GetNode()->GetId() << '/';
+        sampler->AddColumn(prefix.str() + "BufferOccupancy", aggregateSwitch, "BufferOccupancy");
+        sampler->AddColumn(prefix.str() + "MemoryOccupancy", aggregateSwitch, "MemoryOccupancy");
+    }
+}
+
+void
+StateSamplerHelper::Install(ApplicationContainer apps)
+{
+    for (auto i = apps.Begin(); i != apps.End(); ++i)
+    {
+        Install(*i);
+    }
+}
+
+void
+StateSamplerHelper::Install(Ptr<QueueDisc> queue, const std::string& name)
+{
+    Ptr<StateSampler> sampler = GetSampler();
+    sampler->AddColumn(name + "/PacketsInQueue", queue, "PacketsInQueue");
+    sampler->AddColumn(name + "/BytesInQueue", queue, "BytesInQueue");
+}
+
+void
+StateSamplerHelper::Start(Time start, Time stop)
+{
+    Ptr<StateSampler> sampler = GetSampler();
+    sampler->Start(start);
+    sampler->Stop(stop);
+}
+
+} // namespace ns3
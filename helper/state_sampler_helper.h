@@ -0,0 +1,82 @@
+#ifndef STATE_SAMPLER_HELPER_H
+#define STATE_SAMPLER_HELPER_H
+
+#include <ns3/application-container.h>
+#include <ns3/object-factory.h>
+#include <ns3/queue-disc.h>
+#include <ns3/state_sampler.h>
+
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Sample the window state of workers and the slot occupancy of
+ *        switches into one time series file.
+ */
+class StateSamplerHelper
+{
+  public:
+    /**
+     * Create StateSamplerHelper writing rows to fileName every interval.
+     *
+     * \param fileName The time series file
+     * \param interval The time between two rows
+     */
+    StateSamplerHelper(const std::string& fileName, Time interval);
+
+    /**
+     * Record an attribute to be set in the sampler.
+     *
+     * \param name the name of the attribute to set
+     * \param value the value of the attribute to set
+     */
+    void SetAttribute(std::string name, const AttributeValue& value);
+
+    /**
+     * Add columns for the traced state of an application. Workers add their
+     * congestion and aggregation windows and last GACK / AACK, switches add
+     * their slot occupancy.
+     *
+     * \param app Smart pointer to a CustomClient or AggregateSwitch application.
+     */
+    void Install(Ptr<Application> app);
+
+    /**
+     * Add columns for the traced state of every application in a container.
+     *
+     * \param apps The applications.
+     */
+    void Install(ApplicationContainer apps);
+
+    /**
+     * Add the packet and byte length columns of a queue disc.
+     *
+     * \param queue The queue disc.
+     * \param name Column prefix of the queue disc.
+     */
+    void Install(Ptr<QueueDisc> queue, const std::string& name);
+
+    /**
+     * Sample from start to stop. Call after every Install.
+     *
+     * \param start Delay of the first row
+     * \param stop Time of the last row
+     */
+    void Start(Time start, Time stop);
+
+    /**
+     * \returns the sampler, created on first use
+     */
+    Ptr<StateSampler> GetSampler();
+
+  private:
+    ObjectFactory m_factory;      //!< Object factory of the sampler
+    Ptr<StateSampler> m_sampler;  //!< The sampler
+};
+
+} // namespace ns3
+
+#endif /* STATE_SAMPLER_HELPER_H */
@@ -1,9 +1,12 @@
 #include "aggregate_switch.h"
 
+#include "ns3/abort.h"
 #include "ns3/address-utils.h"
+#include "ns3/data-rate.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/ipv4-packet-info-tag.h"
 #include "ns3/ipv6-address.h"
 #include "ns3/log.h"
 #include "ns3/nstime.h"
@@ -13,7 +16,12 @@
 #include "ns3/socket.h"
 #include "ns3/udp-socket.h"
 #include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/pointer.h"
+#include "ns3/boolean.h"
 
+#include <cctype>
+#include <cmath>
 #include "ns3/my_utils.h"
 
 namespace ns3
@@ -47,6 +55,167 @@ AggregateSwitch::GetTypeId()
                           UintegerValue(1),
                           MakeUintegerAccessor(&AggregateSwitch::m_maxParts),
                           MakeUintegerChecker<uint8_t>())
+            .AddAttribute("Quorum",
+                          "Parts a gradient completes with, the result carries the contributor "
+                          "bitmap and the quorum so the PS completes it too (zero waits for MaxParts)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&AggregateSwitch::m_quorum),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("LatePolicy",
+                          "What happens to the parts arriving after a quorum result, Fold "
+                          "forwards them to the PS",
+                          EnumValue(LATE_DROP),
+                          MakeEnumAccessor<LatePolicy>(&AggregateSwitch::m_latePolicy),
+                          MakeEnumChecker(LATE_DROP, "Drop",
+                                          LATE_FOLD, "Fold"))
+            .AddAttribute("MembershipTimeout",
+                          "Time before a membership change the PS has not acknowledged is resent",
+                          TimeValue(MilliSeconds(10)),
+                          MakeTimeAccessor(&AggregateSwitch::m_membershipTimeout),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("Protocol",
+                          "Aggregation protocol of the jobs. PS relays every gradient to the PS, ATP "
+                          "aggregates without GACKs, PA-ATP aggregates and GACKs, SwitchML reuses a "
+                          "fixed slot pool and returns results to the workers",
+                          EnumValue(PROTOCOL_PA_ATP),
+                          MakeEnumAccessor<ProtocolMode>(&AggregateSwitch::m_protocol),
+                          MakeEnumChecker(PROTOCOL_PS, "PS",
+                                          PROTOCOL_ATP, "ATP",
+                                          PROTOCOL_PA_ATP, "PA-ATP",
+                                          PROTOCOL_SWITCHML, "SwitchML"))
+            .AddAttribute("SlotPoolSize",
+                          "Slots per job in SwitchML mode, seq s aggregates in slot s % SlotPoolSize",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&AggregateSwitch::m_slotPool),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("DataType",
+                          "Element type of the gradient values",
+                          EnumValue(INT32),
+                          MakeEnumAccessor<AggregationDataType>(&AggregateSwitch::m_dataType),
+                          MakeEnumChecker(INT32, "Int32",
+                                          FLOAT32, "Float32",
+                                          FLOAT16, "Float16",
+                                          BFLOAT16, "BFloat16"))
+            .AddAttribute("ReduceOp",
+                          "Reduction applied element wise to the gradient values",
+                          EnumValue(REDUCE_SUM),
+                          MakeEnumAccessor<ReduceOp>(&AggregateSwitch::m_reduceOp),
+                          MakeEnumChecker(REDUCE_SUM, "Sum",
+                                          REDUCE_MAX, "Max",
+                                          REDUCE_MIN, "Min"))
+            .AddAttribute("BufferSize",
+                          "Aggregator slots of the switch when MemoryBytes is zero",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&AggregateSwitch::m_bufferSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("SlotIndex",
+                          "How gradients are mapped to slots, Hash indexes BufferSize slots by "
+                          "( jobId, seq )",
+                          EnumValue(INDEX_ASSOCIATIVE),
+                          MakeEnumAccessor<SlotIndex>(&AggregateSwitch::m_slotIndex),
+                          MakeEnumChecker(INDEX_ASSOCIATIVE, "Associative",
+                                          INDEX_HASH, "Hash"))
+            .AddAttribute("CollisionPolicy",
+                          "What a hash indexed switch does when the slot of a new gradient is taken",
+                          EnumValue(COLLISION_FORWARD),
+                          MakeEnumAccessor<CollisionPolicy>(&AggregateSwitch::m_collisionPolicy),
+                          MakeEnumChecker(COLLISION_FORWARD, "Forward",
+                                          COLLISION_LINEAR_PROBE, "LinearProbe",
+                                          COLLISION_MULTI_HASH, "MultiHash"))
+            .AddAttribute("ProbeLimit",
+                          "Candidate slots a LinearProbe or MultiHash lookup tries",
+                          UintegerValue(4),
+                          MakeUintegerAccessor(&AggregateSwitch::m_probeLimit),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Preemption",
+                          "Whether a gradient finding no room takes the slot of a stalled or lower "
+                          "priority job, flushing its partial aggregate to the PS",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&AggregateSwitch::m_preemption),
+                          MakeBooleanChecker())
+            .AddAttribute("PreemptIdleTime",
+                          "Time without gradients after which the slots of a job can be preempted "
+                          "regardless of priority",
+                          TimeValue(MilliSeconds(10)),
+                          MakeTimeAccessor(&AggregateSwitch::m_preemptIdleTime),
+                          MakeTimeChecker())
+            .AddAttribute("ProgressWindow",
+                          "Decay time constant of the completed slots a job priority counts",
+                          TimeValue(MilliSeconds(10)),
+                          MakeTimeAccessor(&AggregateSwitch::m_progressWindow),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("MemoryBytes",
+                          "Aggregator memory of the switch in bytes, summed over the pipeline "
+                          "stages (zero budgets BufferSize slots instead)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&AggregateSwitch::m_memoryBytes),
+                          MakeUintegerChecker<uint64_t>())
+            .AddAttribute("PipelineStages",
+                          "Pipeline stages the aggregator memory and every slot are striped over",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&AggregateSwitch::m_pipelineStages),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("SlotOverhead",
+                          "Metadata bytes a slot takes in every stage (key, bitmap, counter)",
+                          UintegerValue(8),
+                          MakeUintegerAccessor(&AggregateSwitch::m_slotOverhead),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ResultCacheSize",
+                          "Completed results kept until their AACK to answer retransmits at the "
+                          "switch (zero disables the cache)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&AggregateSwitch::m_resultCacheSize),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("SparseSlotElements",
+                          "Number of dense elements a slot holds for sparse gradients, "
+                          "pairs indexing beyond it fall back to the PS",
+                          UintegerValue(1024),
+                          MakeUintegerAccessor(&AggregateSwitch::m_sparseSlotElements),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("GackBatchSize",
+                          "Number of received gradients acknowledged by one cumulative GACK "
+                          "(1 sends a GACK per gradient)",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&AggregateSwitch::m_gackBatchSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("GackDelay",
+                          "Max time a partial GACK batch is held before it is sent, "
+                          "required when GackBatchSize is above 1",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&AggregateSwitch::m_gackDelay),
+                          MakeTimeChecker())
+            .AddAttribute("ShardSize",
+                          "Number of consecutive gradient seqs mapped to one PS shard",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&AggregateSwitch::m_shardSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("PipelineLatency",
+                          "Time one pass through the switch pipeline takes",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&AggregateSwitch::m_pipelineLatency),
+                          MakeTimeChecker())
+            .AddAttribute("ElementsPerPass",
+                          "Gradient elements aggregated in one pipeline pass, larger payloads are "
+                          "recirculated (zero aggregates any payload in one pass)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&AggregateSwitch::m_elementsPerPass),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("PortProcessingRate",
+                          "Rate the pipeline processes the packets of one ingress port at, every "
+                          "pass counts (zero does not cap it)",
+                          DataRateValue(DataRate("0bps")),
+                          MakeDataRateAccessor(&AggregateSwitch::m_portRate),
+                          MakeDataRateChecker())
+            .AddAttribute("Stats",
+                          "Metrics collector the switch reports fallbacks to",
+                          PointerValue(),
+                          MakePointerAccessor(&AggregateSwitch::m_stats),
+                          MakePointerChecker<JobStats>())
+            .AddAttribute("EventTrace",
+                          "Binary event log the switch records to",
+                          PointerValue(),
+                          MakePointerAccessor(&AggregateSwitch::m_eventTrace),
+                          MakePointerChecker<EventTrace>())
             .AddAttribute("RemoteAddress",
                           "The destination Address of the outbound packets",
                           AddressValue(),
@@ -57,6 +226,26 @@ AggregateSwitch::GetTypeId()
                           UintegerValue(0),
                           MakeUintegerAccessor(&AggregateSwitch::m_peerPort),
                           MakeUintegerChecker<uint16_t>())
+            .AddTraceSource("BufferOccupancy",
+                            "Number of aggregation slots in use",
+                            MakeTraceSourceAccessor(&AggregateSwitch::m_bufferOccupancy),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("MemoryOccupancy",
+                            "Bytes of aggregator memory in use",
+                            MakeTraceSourceAccessor(&AggregateSwitch::m_memoryOccupancy),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("MemoryHighWater",
+                            "Most bytes of aggregator memory in use at once",
+                            MakeTraceSourceAccessor(&AggregateSwitch::m_memoryHighWater),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("ResultCacheOccupancy",
+                            "Number of completed results in the cache",
+                            MakeTraceSourceAccessor(&AggregateSwitch::m_resultCacheOccupancy),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("Recirculations",
+                            "Extra pipeline passes taken by payloads larger than ElementsPerPass",
+                            MakeTraceSourceAccessor(&AggregateSwitch::m_recirculations),
+                            "ns3::TracedValueCallback::Uint32")
             .AddTraceSource("Rx",
                             "A packet has been received",
                             MakeTraceSourceAccessor(&AggregateSwitch::m_rxTrace),
@@ -84,6 +273,14 @@ AggregateSwitch::AggregateSwitch()
     m_data = nullptr;
     m_sent = 0;
     m_buffer.clear();
+    m_bufferOccupancy = 0;
+    m_gackState.clear();
+    m_pool.clear();
+    m_resultCache.clear();
+    m_recirculations = 0;
+    m_memoryOccupancy = 0;
+    m_memoryHighWater = 0;
+    m_resultCacheOccupancy = 0;
 }
 
 AggregateSwitch::~AggregateSwitch()
@@ -117,6 +314,11 @@ AggregateSwitch::StartApplication()
 {
     NS_LOG_FUNCTION(this);
 
+    // Without the timer the tail of a job, or a batch wider than the window, is never acknowledged
+    NS_ABORT_MSG_IF(m_gackBatchSize > 1 && m_gackDelay.IsZero(), "GackBatchSize above 1 needs a GackDelay");
+    m_aggregator = CreateAggregator(m_dataType, m_reduceOp);
+    m_index.assign(m_slotIndex == INDEX_HASH ? m_bufferSize : 0, std::string());
+
     if (!m_socket)
     {
         TypeId tid = TypeId::LookupByName("ns3::UdpSocketFactory");
@@ -166,6 +368,7 @@ AggregateSwitch::StartApplication()
     }
 
     m_socket->SetIpTos(m_tos); // Affects only IPv4 sockets.
+    m_socket->SetRecvPktInfo(true);    // The ingress interface picks the pipeline port
     m_socket->SetRecvCallback(MakeCallback(&AggregateSwitch::HandleRead, this));
     m_socket->SetAllowBroadcast(true);
 }
@@ -185,6 +388,21 @@ AggregateSwitch::StopApplication()
         m_socket6->Close();
         m_socket6->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
     }
+
+    for (auto& state : m_gackState)
+    {
+        Simulator::Cancel(state.second.timer);
+    }
+    for (auto& log : m_membershipLog)
+    {
+        Simulator::Cancel(log.second.timer);
+    }
+    for (EventId& event : m_processEvents)
+    {
+        Simulator::Cancel(event);
+    }
+    m_processEvents.clear();
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch memory high water " << m_memoryHighWater << " bytes");
 }
 
 void
@@ -210,9 +428,35 @@ AggregateSwitch::SetFill(std::string fill)
 }
 
 void
-AggregateSwitch::SendResult()
+AggregateSwitch::SetFill(std::string fill, const std::vector<uint8_t>& payload)
 {
-    NS_LOG_FUNCTION(this);
+    NS_LOG_FUNCTION(this << fill << payload.size());
+
+    uint32_t dataSize = fill.size() + 1 + payload.size();
+
+    if (dataSize != m_dataSize)
+    {
+        delete[] m_data;
+        m_data = new uint8_t[dataSize];
+        m_dataSize = dataSize;
+    }
+
+    memcpy(m_data, fill.c_str(), fill.size() + 1);
+    if (!payload.empty())
+    {
+        memcpy(m_data + fill.size() + 1, payload.data(), payload.size());
+    }
+
+    //
+    // Overwrite packet size attribute.
+    //
+    m_size = dataSize;
+}
+
+void
+AggregateSwitch::SendResult(uint32_t seq)
+{
+    NS_LOG_FUNCTION(this << seq);
     Ptr<Packet> p;
     if (m_dataSize)
     {
@@ -239,37 +483,256 @@ AggregateSwitch::SendResult()
         //
         p = Create<Packet>(m_size);
     }
+    LatencyTag path;
+    path.SetSeq(seq);
+    path.SetSlotComplete(Simulator::Now());
+    p->AddPacketTag(path);
     Address localAddress;
     m_socket->GetSockName(localAddress);
+    Address dstAddress = GetParameterServer(seq);
     // call to the trace sinks before the packet is actually sent,
     // so that tags added to the packet can be sent as well
     m_fwTrace(p);
-    if (Ipv4Address::IsMatchingType(m_peerAddr))
-    {
-        m_fwTraceWithAddresses(
-            p,
-            localAddress,
-            InetSocketAddress(Ipv4Address::ConvertFrom(m_peerAddr), m_peerPort));
-    }
-    Address dstAddress = InetSocketAddress(Ipv4Address::ConvertFrom(m_peerAddr), m_peerPort);
+    m_fwTraceWithAddresses(p, localAddress, dstAddress);
     m_socket->SendTo(p, 0, dstAddress);
     ++m_sent;
 
-    if (Ipv4Address::IsMatchingType(m_peerAddr))
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch sent result ( "
+                << InetSocketAddress::ConvertFrom(dstAddress).GetIpv4() << " port "
+                << InetSocketAddress::ConvertFrom(dstAddress).GetPort() << " )");
+}
+
+void
+AggregateSwitch::AddParameterServer(Address ip, uint16_t port)
+{
+    NS_LOG_FUNCTION(this << ip << port);
+    m_shards.push_back(InetSocketAddress(Ipv4Address::ConvertFrom(ip), port));
+}
+
+uint32_t
+AggregateSwitch::GetMemoryHighWater() const
+{
+    return m_memoryHighWater;
+}
+
+uint16_t
+AggregateSwitch::GetQuorum() const
+{
+    return (m_quorum == 0 || m_quorum > m_maxParts) ? m_maxParts : m_quorum;
+}
+
+void
+AggregateSwitch::AddMember(uint16_t jobId, uint16_t partId, uint32_t fromSeq)
+{
+    NS_LOG_FUNCTION(this << jobId << partId << fromSeq);
+    std::string job = std::to_string(jobId);
+    std::map<uint16_t, uint32_t>& members = GetMembers(job);
+    if (!members.insert(std::make_pair(partId, fromSeq)).second)
+    {
+        return;
+    }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch added part " << partId << " to job " << jobId
+                << " from seq " << fromSeq << " ( " << members.size() << " members )");
+    SendMembership(job, "JOIN," + job + ',' + std::to_string(partId) + ',' + std::to_string(fromSeq));
+    if (m_stats)
     {
-        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch sent result ( " 
-                    << Ipv4Address::ConvertFrom(m_peerAddr)
-                    << " port " << m_peerPort << " )");
+        m_stats->RecordMembershipChange(jobId);
     }
-    else if (InetSocketAddress::IsMatchingType(m_peerAddr))
+    if (m_eventTrace)
     {
-        NS_LOG_INFO(
-            Simulator::Now().As(Time::S) << " switch sent result ( "
-            << InetSocketAddress::ConvertFrom(m_peerAddr).GetIpv4() << " port "
-            << InetSocketAddress::ConvertFrom(m_peerAddr).GetPort() << " )");
+        m_eventTrace->Record(EVENT_SWITCH_MEMBERSHIP, GetNode()->GetId(), jobId, fromSeq, members.size());
     }
 }
 
+void
+AggregateSwitch::RemoveMember(uint16_t jobId, uint16_t partId)
+{
+    NS_LOG_FUNCTION(this << jobId << partId);
+    std::string job = std::to_string(jobId);
+    std::map<uint16_t, uint32_t>& members = GetMembers(job);
+    if (members.erase(partId) == 0)
+    {
+        return;
+    }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch removed part " << partId << " from job " << jobId
+                << " ( " << members.size() << " members )");
+    SendMembership(job, "LEAVE," + job + ',' + std::to_string(partId));
+    if (m_stats)
+    {
+        m_stats->RecordMembershipChange(jobId);
+    }
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(EVENT_SWITCH_MEMBERSHIP, GetNode()->GetId(), jobId, GetJobFrontier(jobId),
+                             members.size());
+    }
+
+    // The worker gets no more GACKs or AACKs
+    std::string worker = job + ',' + std::to_string(partId);
+    auto gack = m_gackState.find(worker);
+    if (gack != m_gackState.end())
+    {
+        Simulator::Cancel(gack->second.timer);
+        m_gackState.erase(gack);
+    }
+
+    // Slots are keyed jobId,seq so the job's slots are one contiguous run
+    std::string prefix = job + ',';
+    for (auto it = m_lateParts.lower_bound(prefix);
+         it != m_lateParts.end() && it->first.compare(0, prefix.size(), prefix) == 0;)
+    {
+        it->second.erase(partId);
+        it = it->second.empty() ? m_lateParts.erase(it) : std::next(it);
+    }
+    std::vector<std::string> complete;
+    for (auto it = m_buffer.lower_bound(prefix);
+         it != m_buffer.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it)
+    {
+        std::string seq = it->first.substr(prefix.size());
+        if (IsComplete(job, std::stoul(seq), it->second.parts))
+        {
+            complete.push_back(seq);
+        }
+    }
+    for (const std::string& seq : complete)
+    {
+        SendSlot("RESULT", job, seq);
+    }
+    for (auto it = m_pool.lower_bound(prefix);
+         it != m_pool.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it)
+    {
+        if (it->second.busy && IsComplete(job, it->second.seq, it->second.slot.parts))
+        {
+            CompletePool(job, it->second);
+        }
+    }
+}
+
+std::map<uint16_t, uint32_t>&
+AggregateSwitch::GetMembers(std::string jobId)
+{
+    auto it = m_members.find(jobId);
+    if (it == m_members.end())
+    {
+        // A static job becomes elastic, parts 0 .. MaxParts - 1 were there from the start
+        it = m_members.emplace(jobId, std::map<uint16_t, uint32_t>()).first;
+        for (uint16_t part = 0; part < m_maxParts; part++)
+        {
+            it->second[part] = 0;
+        }
+    }
+    return it->second;
+}
+
+uint32_t
+AggregateSwitch::GetJobFrontier(uint16_t jobId) const
+{
+    auto it = m_jobFrontier.find(std::to_string(jobId));
+    return it == m_jobFrontier.end() ? 0 : it->second;
+}
+
+std::set<uint16_t>
+AggregateSwitch::GetExpectedParts(std::string jobId, uint32_t seq) const
+{
+    std::set<uint16_t> expected;
+    auto members = m_members.find(jobId);
+    if (members == m_members.end())
+    {
+        for (uint16_t part = 0; part < m_maxParts; part++)
+        {
+            expected.insert(part);
+        }
+        return expected;
+    }
+    for (const auto& member : members->second)
+    {
+        if (member.second <= seq)
+        {
+            expected.insert(member.first);
+        }
+    }
+    return expected;
+}
+
+bool
+AggregateSwitch::IsComplete(std::string jobId, uint32_t seq, const std::set<uint16_t>& parts) const
+{
+    std::set<uint16_t> expected = GetExpectedParts(jobId, seq);
+    // Parts of a worker that left still add to the values, but no longer to the count
+    size_t present = 0;
+    for (uint16_t part : parts)
+    {
+        present += expected.count(part);
+    }
+    return present >= GetQuorum(jobId, seq);
+}
+
+uint16_t
+AggregateSwitch::GetQuorum(std::string jobId, uint32_t seq) const
+{
+    size_t expected = GetExpectedParts(jobId, seq).size();
+    return (m_quorum == 0 || m_quorum > expected) ? expected : m_quorum;
+}
+
+bool
+AggregateSwitch::TracksLateParts() const
+{
+    return GetQuorum() < m_maxParts || !m_members.empty();
+}
+
+uint32_t
+AggregateSwitch::GetSlotMemory(uint32_t valueBytes) const
+{
+    return m_pipelineStages * ((valueBytes + m_pipelineStages - 1) / m_pipelineStages + m_slotOverhead);
+}
+
+bool
+AggregateSwitch::AllocateMemory(std::string jobId, uint32_t bytes)
+{
+    NS_LOG_FUNCTION(this << jobId << bytes);
+    if (m_memoryBytes > 0 && m_memoryOccupancy + bytes > m_memoryBytes)
+    {
+        return false;
+    }
+    m_memoryOccupancy += bytes;
+    if (m_memoryOccupancy > m_memoryHighWater)
+    {
+        m_memoryHighWater = m_memoryOccupancy;
+    }
+    uint32_t& job = m_jobMemory[jobId];
+    job += bytes;
+    if (m_stats)
+    {
+        m_stats->RecordSwitchMemory(std::stoul(jobId), job);
+    }
+    return true;
+}
+
+void
+AggregateSwitch::ReleaseMemory(std::string jobId, uint32_t bytes)
+{
+    NS_LOG_FUNCTION(this << jobId << bytes);
+    m_memoryOccupancy -= bytes;
+    m_jobMemory[jobId] -= bytes;
+}
+
+Address
+AggregateSwitch::GetParameterServer(uint32_t seq) const
+{
+    if (m_shards.empty())
+    {
+        if (InetSocketAddress::IsMatchingType(m_peerAddr))
+        {
+            return m_peerAddr;
+        }
+        return InetSocketAddress(Ipv4Address::ConvertFrom(m_peerAddr), m_peerPort);
+    }
+    // Contiguous ranges of ShardSize seqs are assigned round robin
+    return m_shards[(seq / m_shardSize) % m_shards.size()];
+}
+
 void
 AggregateSwitch::HandleRead(Ptr<Socket> socket)
 {
@@ -284,55 +747,882 @@ AggregateSwitch::HandleRead(Ptr<Socket> socket)
         m_rxTrace(packet);
         m_rxTraceWithAddresses(packet, from, localAddress);
 
-        // Log packet data
-        uint8_t read_buffer[1000];
-        packet->CopyData(read_buffer, packet->GetSize());
-        std::string read_data(read_buffer, read_buffer+packet->GetSize());
-        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch received : " << read_data);
+        // Each packet waits for its ingress port, then takes one pipeline pass per ElementsPerPass elements
+        Time delay = GetPipelineDelay(packet);
+        if (delay.IsPositive())
+        {
+            while (!m_processEvents.empty() && m_processEvents.front().IsExpired())
+            {
+                m_processEvents.pop_front();
+            }
+            m_processEvents.push_back(Simulator::Schedule(delay, &AggregateSwitch::Process, this, packet, from));
+        }
+        else
+        {
+            Process(packet, from);
+        }
+    }
+}
+
+Time
+AggregateSwitch::GetPipelineDelay(Ptr<Packet> packet)
+{
+    NS_LOG_FUNCTION(this << packet);
+    uint32_t passes = 1;
+    if (m_elementsPerPass > 0 && m_aggregator)
+    {
+        std::vector<uint8_t> read_buffer(packet->GetSize() + 1, 0);
+        packet->CopyData(read_buffer.data(), packet->GetSize());
+        std::string read_data(reinterpret_cast<char*>(read_buffer.data()));
         std::vector<std::string> pktGradient = split_string(read_data, (char *)",");
+        // Only gradients ( jobId,partId,seq[,scale[,pairs]] ) carry values to aggregate
+        if (pktGradient.size() > 3 && isdigit(pktGradient[0][0]))
+        {
+            uint32_t valuesSize = packet->GetSize() - std::min<uint32_t>(packet->GetSize(), read_data.size() + 1);
+            uint32_t pairs = (pktGradient.size() > 4) ? std::stoul(pktGradient[4]) : 0;
+            uint32_t elements = pairs > 0 ? pairs : valuesSize / m_aggregator->GetElementSize();
+            passes = std::max<uint32_t>(1, (elements + m_elementsPerPass - 1) / m_elementsPerPass);
+        }
+    }
+    if (passes > 1)
+    {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch recirculates packet " << packet->GetUid() << " "
+                    << passes - 1 << " times");
+        m_recirculations += passes - 1;
+    }
 
-        // Broadcast to workers
-        if (pktGradient[0] == "AACK") {
-            Address dstAddress = InetSocketAddress(Ipv4Address("255.255.255.255"), m_peerPort);
-            socket->SendTo(packet, 0, from);
+    // Recirculated passes come back through the same port and use its processing rate again
+    uint32_t port = 0;
+    Ipv4PacketInfoTag info;
+    if (packet->PeekPacketTag(info))
+    {
+        port = info.GetRecvIf();
+    }
+    Time now = Simulator::Now();
+    Time pass = m_portRate.GetBitRate() > 0 ? m_portRate.CalculateBytesTxTime(packet->GetSize()) : Seconds(0);
+    Time start = std::max(now, m_portBusyUntil[port]);
+    m_portBusyUntil[port] = start + pass * passes;
+    return start - now + (pass + m_pipelineLatency) * passes;
+}
+
+void
+AggregateSwitch::Process(Ptr<Packet> packet, Address from)
+{
+    NS_LOG_FUNCTION(this << packet << from);
+
+    // Log packet data
+    std::vector<uint8_t> read_buffer(packet->GetSize() + 1, 0);
+    packet->CopyData(read_buffer.data(), packet->GetSize());
+    std::string read_data(reinterpret_cast<char*>(read_buffer.data()));   // Header up to the terminator
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch received : " << read_data);
+    std::vector<std::string> pktGradient = split_string(read_data, (char *)",");
+
+    if (pktGradient[0] == "JOIN" || pktGradient[0] == "LEAVE") {
+        HandleMembership(pktGradient, from);
+        return;
+    }
+    if (pktGradient[0] == "MACK") {
+        HandleMembershipAck(pktGradient, from);
+        return;
+    }
+
+    // Broadcast to workers
+    if (pktGradient[0] == "AACK") {
+        std::set<uint32_t> seqs;
+        for (size_t i = 2; i < pktGradient.size(); i++) {
+            decode_range(pktGradient[i], seqs);
+        }
+        for (uint32_t seq : seqs) {
+            std::string key = pktGradient[1] + ',' + std::to_string(seq);
+            m_forwarded.erase(key);
+            m_resultCache.erase(key);
+            // Parts still missing are told apart by the AACKs seen from now on
+            m_lateParts.erase(key);
+        }
+        if (m_resultCacheSize > 0 || TracksLateParts()) {
+            // The PS has every seq of the AACK, only the AACK can still be lost
+            AackSeen& seen = m_aackSeen[pktGradient[1]];
+            seen.above.insert(seqs.lower_bound(seen.next), seqs.end());
+            while (!seen.above.empty() && *seen.above.begin() == seen.next) {
+                seen.above.erase(seen.above.begin());
+                seen.next++;
+            }
+            while (!m_resultCacheOrder.empty() && !m_resultCache.count(m_resultCacheOrder.front())) {
+                m_resultCacheOrder.pop_front();
+            }
+            m_resultCacheOccupancy = m_resultCache.size();
+        }
+        ForwardAack(packet, pktGradient[1]);
+        return;
+    }
+
+    // Gradients of workers that left, or from before a worker joined, are not expected by any slot
+    auto members = m_members.find(pktGradient[0]);
+    if (members != m_members.end()) {
+        auto member = members->second.find(std::stoi(pktGradient[1]));
+        if (member == members->second.end() || std::stoul(pktGradient[2]) < member->second) {
+            NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch dropped " << pktGradient[2] << " of non member "
+                        << pktGradient[0] << ',' << pktGradient[1]);
             return;
         }
+    }
 
-        // GACK
-        SetFill("GACK," + pktGradient[2]);
-        Ptr<Packet> pktGACK;
-        pktGACK = Create<Packet>(m_data, m_dataSize);
-        socket->SendTo(pktGACK, 0, from);
+    // Stamp the arrival, the stamps travel on with the GACK and any fallback
+    LatencyTag path;
+    bool tagged = packet->PeekPacketTag(path);
+    if (tagged) {
+        path.SetSwitchArrival(Simulator::Now());
+        packet->ReplacePacketTag(path);
+    }
 
-        if (InetSocketAddress::IsMatchingType(from))
-        {
-            NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch sent GACK ( "
-                        << InetSocketAddress::ConvertFrom(from).GetIpv4() << " port "
-                        << InetSocketAddress::ConvertFrom(from).GetPort() << " )");
-        }
-        
-        // Buffer
-        if (m_buffer.size() >= m_bufferSize) {
-            NS_LOG_INFO(Simulator::Now().As(Time::S) << " buffer overflow");
-            // IMPLEMENT FORWARDING
+    if (m_eventTrace) {
+        m_eventTrace->Record(EVENT_SWITCH_RX, GetNode()->GetId(), std::stoi(pktGradient[0]),
+                             std::stoul(pktGradient[2]), packet->GetSize());
+    }
+
+    m_jobProgress[pktGradient[0]].active = Simulator::Now();
+    uint32_t& frontier = m_jobFrontier[pktGradient[0]];
+    frontier = std::max<uint32_t>(frontier, std::stoul(pktGradient[2]) + 1);
+
+    // GACK
+    UpdateGack(pktGradient[0] + ',' + pktGradient[1], std::stoul(pktGradient[2]), from, path, tagged);
+
+    // Plain PS baseline, the switch only relays
+    if (m_protocol == PROTOCOL_PS) {
+        m_socket->SendTo(packet, 0, GetParameterServer(std::stoul(pktGradient[2])));
+        return;
+    }
+
+    // Format : jobId,partId,gradientId[,scale[,pairs]] followed by the values
+    uint32_t elementSize = m_aggregator->GetElementSize();
+    const uint8_t* values = read_buffer.data() + read_data.size() + 1;
+    uint32_t valuesSize = packet->GetSize() - std::min<uint32_t>(packet->GetSize(), read_data.size() + 1);
+    uint32_t pairs = (pktGradient.size() > 4) ? std::stoul(pktGradient[4]) : 0;
+    if (static_cast<uint64_t>(pairs) * (sizeof(uint32_t) + elementSize) > valuesSize) {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch dropped truncated sparse gradient " << pktGradient[0]
+                    << ',' << pktGradient[2] << " ( " << pairs << " pairs in " << valuesSize << " bytes )");
+        return;
+    }
+    // Indices absent from a sparse block are zeros, only a sum leaves them out unchanged
+    NS_ABORT_MSG_IF(pairs > 0 && m_reduceOp != REDUCE_SUM, "Sparse gradients (TopK) need ReduceOp Sum");
+
+    if (m_protocol == PROTOCOL_SWITCHML) {
+        AggregatePool(pktGradient, values, valuesSize, from);
+        return;
+    }
+
+    if (TracksLateParts() && HandleLate(packet, pktGradient[0], pktGradient[1], std::stoul(pktGradient[2]))) {
+        return;
+    }
+
+    if (m_resultCacheSize > 0 && AnswerFromCache(pktGradient[0], pktGradient[1], std::stoul(pktGradient[2]), from)) {
+        return;
+    }
+
+    std::string key = pktGradient[0] + ',' + pktGradient[2];
+    if (pairs > 0) {
+        // Pairs are in index order, so the last one bounds the dense slot they scatter into
+        uint32_t lastIndex;
+        memcpy(&lastIndex, values + (pairs - 1) * (sizeof(uint32_t) + elementSize), sizeof(uint32_t));
+        if (lastIndex >= m_sparseSlotElements) {
+            NS_LOG_INFO(Simulator::Now().As(Time::S) << " sparse index " << lastIndex
+                        << " outside slot, forwarding " << key << " to PS");
+            FallBack(packet, pktGradient[0], pktGradient[2]);
             return;
         }
-        std::string key = pktGradient[0] + ',' + pktGradient[2];
-        uint16_t part = std::stoi(pktGradient[1]);
-        auto ret = m_buffer.insert(std::pair<std::string, std::set<uint16_t>>(key, std::set<uint16_t>({part})));
-        if (ret.second == false) {      // Already exists in m_buffer
-            auto retSet = m_buffer[key].insert(part);       // Insert new part
-            if (retSet.second == false) {       // Duplicate part
-                NS_LOG_INFO(Simulator::Now().As(Time::S) << " ERROR: part duplicate found");
+    }
+
+    // Buffer, a new slot needs a free entry or, with MemoryBytes set, room for its values
+    uint32_t valueBytes = 0;
+    if (pktGradient.size() > 3) {
+        valueBytes = pairs > 0 ? m_sparseSlotElements * elementSize : valuesSize / elementSize * elementSize;
+    }
+    uint32_t memory = GetSlotMemory(valueBytes);
+    uint32_t index = 0;
+    bool overflow = m_forwarded.count(key) > 0;
+    if (!overflow && !m_buffer.count(key)) {
+        std::vector<std::string> held;
+        if (m_slotIndex == INDEX_HASH) {
+            overflow = !FindFreeIndex(pktGradient[0], std::stoul(pktGradient[2]), index, held);
+        }
+        else {
+            overflow = m_memoryBytes == 0 && m_buffer.size() >= m_bufferSize;
+        }
+        if (overflow && m_preemption) {
+            overflow = !Preempt(pktGradient[0], held, index);
+        }
+        // Freeing a slot entry may not free enough bytes, keep preempting until the values fit
+        uint32_t freed;
+        while (!overflow && !AllocateMemory(pktGradient[0], memory)) {
+            overflow = !m_preemption || !Preempt(pktGradient[0], {}, freed);
+        }
+    }
+    if (overflow) {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " buffer overflow, forwarding " << key << " to PS");
+        FallBack(packet, pktGradient[0], pktGradient[2]);
+        return;
+    }
+
+    uint16_t part = std::stoi(pktGradient[1]);
+    auto ret = m_buffer.insert(std::pair<std::string, Slot>(key, Slot()));
+    m_bufferOccupancy = m_buffer.size();
+    Slot& slot = ret.first->second;
+    if (ret.second) {
+        slot.memory = memory;
+        slot.index = index;
+        slot.updated = Simulator::Now();
+        if (m_slotIndex == INDEX_HASH) {
+            m_index[index] = key;
+        }
+    }
+    auto retSet = slot.parts.insert(part);       // Insert new part
+    if (retSet.second == false) {       // Duplicate part
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " ERROR: part duplicate found");
+        return;
+    }
+    MergeSlot(slot, ret.second, pktGradient, values, valuesSize);
+    slot.updated = Simulator::Now();
+    if (IsComplete(pktGradient[0], std::stoul(pktGradient[2]), slot.parts)) {       // Check if enough parts present, perform aggregation
+        SendSlot("RESULT", pktGradient[0], pktGradient[2]);
+    }
+}
+
+void
+AggregateSwitch::MergeSlot(Slot& slot,
+                           bool fresh,
+                           const std::vector<std::string>& pktGradient,
+                           const uint8_t* values,
+                           uint32_t valuesSize)
+{
+    if (pktGradient.size() <= 3) {
+        return;     // Header only gradient, nothing to reduce
+    }
+    uint32_t elementSize = m_aggregator->GetElementSize();
+    uint32_t pairs = (pktGradient.size() > 4) ? std::stoul(pktGradient[4]) : 0;
+    if (pairs > 0) {
+        // Sparse blocks scatter into a dense slot, absent indices stay zero
+        slot.values.resize(std::max<size_t>(slot.values.size(), m_sparseSlotElements * elementSize), 0);
+    }
+    std::vector<uint8_t> aligned;
+    if (fresh || slot.scale.empty()) {
+        slot.scale = pktGradient[3];
+    }
+    else if (std::stod(pktGradient[3]) < std::stod(slot.scale)) {
+        // Workers pick their own scale, the slot moves to the smaller one so no contribution saturates
+        m_aggregator->Rescale(slot.values.data(), slot.values.size() / elementSize,
+                              std::stod(pktGradient[3]) / std::stod(slot.scale));
+        slot.scale = pktGradient[3];
+    }
+    else if (std::stod(pktGradient[3]) > std::stod(slot.scale)) {
+        // Contribution quantized finer than the slot, bring it to the slot scale
+        aligned.assign(slot.values.size(), 0);
+        if (pairs > 0) {
+            m_aggregator->MergeSparse(aligned.data(), values, pairs);
+            pairs = 0;
+        }
+        else {
+            aligned.assign(values, values + std::min<uint32_t>(valuesSize, slot.values.size()) / elementSize * elementSize);
+        }
+        m_aggregator->Rescale(aligned.data(), aligned.size() / elementSize,
+                              std::stod(slot.scale) / std::stod(pktGradient[3]));
+        values = aligned.data();
+        valuesSize = aligned.size();
+    }
+    if (pairs > 0) {
+        m_aggregator->MergeSparse(slot.values.data(), values, pairs);
+    }
+    else if (fresh) {
+        slot.values.assign(values, values + valuesSize / elementSize * elementSize);
+    }
+    else {
+        m_aggregator->Merge(slot.values.data(), values, std::min<uint32_t>(valuesSize, slot.values.size()) / elementSize);
+    }
+}
+
+void
+AggregateSwitch::AggregatePool(const std::vector<std::string>& pktGradient,
+                               const uint8_t* values,
+                               uint32_t valuesSize,
+                               Address from)
+{
+    NS_LOG_FUNCTION(this << pktGradient[0] << pktGradient[1] << pktGradient[2]);
+    uint32_t seq = std::stoul(pktGradient[2]);
+    uint32_t pairs = (pktGradient.size() > 4) ? std::stoul(pktGradient[4]) : 0;
+    if (pairs > 0) {
+        uint32_t lastIndex;
+        memcpy(&lastIndex, values + (pairs - 1) * (sizeof(uint32_t) + m_aggregator->GetElementSize()), sizeof(uint32_t));
+        NS_ABORT_MSG_IF(lastIndex >= m_sparseSlotElements,
+                        "SwitchML has no PS to fall back to, SparseSlotElements must cover index " << lastIndex);
+    }
+
+    std::string key = pktGradient[0] + ',' + std::to_string(seq % m_slotPool);
+    PoolSlot& pool = m_pool[key];
+    if (pool.completed && pool.resultSeq == seq) {
+        // The worker lost the result, answer from the shadow copy
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch resent result " << seq << " of slot " << key);
+        Ptr<Packet> p = Create<Packet>(pool.result.data(), pool.result.size());
+        m_socket->SendTo(p, 0, from);
+        return;
+    }
+    if (pool.busy ? pool.seq != seq : (pool.completed && seq < pool.resultSeq)) {
+        // Only a stale retransmit or a worker breaking lock step gets here
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch dropped " << seq << ", slot " << key << " holds "
+                    << pool.seq);
+        return;
+    }
+
+    if (pool.memory == 0) {
+        // Pool slots are static, a slot is charged once and held for the whole run
+        // Sparse pairs scatter into a dense slot, which is what the slot holds
+        uint32_t elementSize = m_aggregator->GetElementSize();
+        uint32_t pairs = (pktGradient.size() > 4) ? std::stoul(pktGradient[4]) : 0;
+        uint32_t valueBytes = 0;
+        if (pktGradient.size() > 3) {
+            valueBytes = pairs > 0 ? m_sparseSlotElements * elementSize : valuesSize / elementSize * elementSize;
+        }
+        pool.memory = GetSlotMemory(valueBytes);
+        NS_ABORT_MSG_IF(!AllocateMemory(pktGradient[0], pool.memory),
+                        "SlotPoolSize slots of job " << pktGradient[0] << " do not fit in MemoryBytes");
+    }
+
+    bool fresh = !pool.busy;
+    if (fresh) {
+        pool.busy = true;
+        pool.seq = seq;
+        pool.slot = Slot();
+        m_bufferOccupancy++;
+    }
+    if (!pool.slot.parts.insert(std::stoi(pktGradient[1])).second) {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " ERROR: part duplicate found");
+        return;
+    }
+    MergeSlot(pool.slot, fresh, pktGradient, values, valuesSize);
+    if (IsComplete(pktGradient[0], seq, pool.slot.parts)) {
+        CompletePool(pktGradient[0], pool);
+    }
+}
+
+void
+AggregateSwitch::CompletePool(std::string jobId, PoolSlot& pool)
+{
+    NS_LOG_FUNCTION(this << jobId << pool.seq);
+    uint32_t seq = pool.seq;
+    // Format : RESULT,jobId,seq,bitmap[,scale] followed by the aggregated values
+    std::string result = "RESULT," + jobId + ',' + std::to_string(seq) + ',' + encode_bitmap(pool.slot.parts);
+    if (!pool.slot.scale.empty()) {
+        result += ',' + pool.slot.scale;
+    }
+    SetFill(result, pool.slot.values);
+    pool.result.assign(m_data, m_data + m_dataSize);
+    pool.busy = false;
+    pool.completed = true;
+    pool.resultSeq = seq;
+    pool.slot = Slot();
+    m_bufferOccupancy--;
+
+    Ptr<Packet> p = Create<Packet>(m_data, m_dataSize);
+    LatencyTag path;
+    path.SetSeq(seq);
+    path.SetSlotComplete(Simulator::Now());
+    p->AddPacketTag(path);
+    ForwardAack(p, jobId);
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(EVENT_SWITCH_RESULT, GetNode()->GetId(), std::stoi(jobId), seq, m_dataSize);
+    }
+}
+
+void
+AggregateSwitch::SendSlot(std::string type, std::string jobId, std::string seq)
+{
+    NS_LOG_FUNCTION(this << type << jobId << seq);
+    std::string key = jobId + ',' + seq;
+    Slot& slot = m_buffer[key];
+    // Format : RESULT,jobId,seq,bitmap,scale,quorum or PARTIAL,jobId,seq,bitmap[,scale]
+    // followed by the aggregated values
+    std::string result = type + ',' + jobId + ',' + seq + ',' + encode_bitmap(slot.parts);
+    if (type == "RESULT") {
+        // The PS must not wait for the parts this quorum left out
+        result += ',' + (slot.scale.empty() ? std::string("1") : slot.scale) + ',' +
+                  std::to_string(GetQuorum(jobId, std::stoul(seq)));
+    }
+    else if (!slot.scale.empty()) {
+        result += ',' + slot.scale;
+    }
+    SetFill(result, slot.values);
+    SendResult(std::stoul(seq));
+    if (type == "RESULT" && m_resultCacheSize > 0)
+    {
+        CacheResult(key);
+    }
+    if (type == "RESULT")
+    {
+        // Expected parts missing from the quorum are late from now on
+        std::set<uint16_t> late;
+        for (uint16_t part : GetExpectedParts(jobId, std::stoul(seq)))
+        {
+            if (!slot.parts.count(part))
+            {
+                late.insert(part);
             }
         }
-        if (m_buffer[key].size() == m_maxParts) {       // Check if all parts present, perform aggregation
-            std::string result = "RESULT," + pktGradient[0] + ',' + pktGradient[2];
-            SetFill(result);
-            SendResult();
-            m_buffer.erase(key);
+        if (!late.empty())
+        {
+            m_lateParts[key] = late;
+        }
+    }
+    if (type == "RESULT")
+    {
+        JobProgress& progress = m_jobProgress[jobId];
+        progress.completed = GetJobPriority(jobId) + 1;
+        progress.updated = Simulator::Now();
+    }
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(type == "RESULT" ? EVENT_SWITCH_RESULT : EVENT_SWITCH_PARTIAL, GetNode()->GetId(),
+                             std::stoi(jobId), std::stoul(seq), m_dataSize);
+    }
+    ReleaseMemory(jobId, slot.memory);
+    if (m_slotIndex == INDEX_HASH)
+    {
+        m_index[slot.index].clear();
+    }
+    m_buffer.erase(key);
+    m_bufferOccupancy = m_buffer.size();
+}
+
+void
+AggregateSwitch::FallBack(Ptr<Packet> packet, std::string jobId, std::string seq)
+{
+    NS_LOG_FUNCTION(this << packet << jobId << seq);
+    std::string key = jobId + ',' + seq;
+    if (m_buffer.count(key)) {
+        // The slot can no longer complete here, hand its partial aggregate to the PS
+        SendSlot("PARTIAL", jobId, seq);
+    }
+    // Later parts of the gradient follow it until its AACK passes through the switch
+    m_forwarded.insert(key);
+    m_socket->SendTo(packet, 0, GetParameterServer(std::stoul(seq)));
+    if (m_stats)
+    {
+        m_stats->RecordFallback(std::stoul(jobId));
+    }
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(EVENT_SWITCH_FALLBACK, GetNode()->GetId(), std::stoi(jobId), std::stoul(seq), packet->GetSize());
+    }
+}
+
+/**
+ * \brief Hash a gradient to a slot of the index.
+ * \param jobId job of the gradient
+ * \param seq gradient seq
+ * \param seed hash function number
+ * \return the hash
+ */
+static uint32_t
+SlotHash(uint32_t jobId, uint32_t seq, uint32_t seed)
+{
+    // splitmix64 finalizer, every seed gives an independent hash function
+    uint64_t x = (static_cast<uint64_t>(jobId) << 32 | seq) ^ (static_cast<uint64_t>(seed) * 0x9e3779b97f4a7c15ULL);
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<uint32_t>(x);
+}
+
+bool
+AggregateSwitch::FindFreeIndex(std::string jobId, uint32_t seq, uint32_t& index, std::vector<std::string>& held)
+{
+    NS_LOG_FUNCTION(this << jobId << seq);
+    uint32_t job = std::stoul(jobId);
+    uint32_t home = SlotHash(job, seq, 0) % m_bufferSize;
+    uint32_t probes = m_collisionPolicy == COLLISION_FORWARD ? 1 : std::min(m_probeLimit, m_bufferSize);
+    bool found = false;
+    for (uint32_t i = 0; i < probes && !found; i++)
+    {
+        if (m_collisionPolicy == COLLISION_MULTI_HASH)
+        {
+            index = i == 0 ? home : SlotHash(job, seq, i) % m_bufferSize;
+        }
+        else
+        {
+            index = (home + i) % m_bufferSize;
         }
+        found = m_index[index].empty();
+        if (!found)
+        {
+            held.push_back(m_index[index]);
+        }
+    }
+    bool collided = !m_index[home].empty();
+    if (collided)
+    {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch slot " << home << " of " << jobId << ',' << seq
+                    << " held by " << m_index[home] << (found ? ", moved to slot " + std::to_string(index) : ""));
+    }
+    if (m_stats)
+    {
+        m_stats->RecordSlotLookup(job, collided, found);
+    }
+    return found;
+}
+
+double
+AggregateSwitch::GetJobPriority(std::string jobId) const
+{
+    auto it = m_jobProgress.find(jobId);
+    if (it == m_jobProgress.end())
+    {
+        return 0;
+    }
+    double age = (Simulator::Now() - it->second.updated).GetSeconds();
+    return it->second.completed * std::exp(-age / m_progressWindow.GetSeconds());
+}
+
+bool
+AggregateSwitch::Preempt(std::string jobId, const std::vector<std::string>& candidates, uint32_t& index)
+{
+    NS_LOG_FUNCTION(this << jobId);
+    double priority = GetJobPriority(jobId);
+    std::string victim;
+    double victimPriority = 0;
+    Time victimUpdated;
+    auto consider = [&](const std::string& key, const Slot& slot) {
+        std::string job = key.substr(0, key.find(','));
+        if (job == jobId)
+        {
+            return;
+        }
+        double jobPriority = GetJobPriority(job);
+        bool idle = Simulator::Now() - m_jobProgress[job].active >= m_preemptIdleTime;
+        if (!idle && jobPriority >= priority)
+        {
+            return;
+        }
+        if (victim.empty() || jobPriority < victimPriority ||
+            (jobPriority == victimPriority && slot.updated < victimUpdated))
+        {
+            victim = key;
+            victimPriority = jobPriority;
+            victimUpdated = slot.updated;
+        }
+    };
+    if (candidates.empty())
+    {
+        for (const auto& entry : m_buffer)
+        {
+            consider(entry.first, entry.second);
+        }
+    }
+    else
+    {
+        for (const std::string& key : candidates)
+        {
+            consider(key, m_buffer[key]);
+        }
+    }
+    if (victim.empty())
+    {
+        return false;
+    }
+
+    size_t comma = victim.find(',');
+    std::string victimJob = victim.substr(0, comma);
+    index = m_buffer[victim].index;
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch preempted slot " << victim << " (priority "
+                << victimPriority << ") for job " << jobId << " (priority " << priority << ")");
+    SendSlot("PARTIAL", victimJob, victim.substr(comma + 1));
+    // The rest of the preempted gradient completes at the PS
+    m_forwarded.insert(victim);
+    if (m_stats)
+    {
+        m_stats->RecordPreemption(std::stoul(victimJob));
+    }
+    return true;
+}
+
+bool
+AggregateSwitch::HandleLate(Ptr<Packet> packet, std::string jobId, std::string partId, uint32_t seq)
+{
+    NS_LOG_FUNCTION(this << jobId << partId << seq);
+    std::string key = jobId + ',' + std::to_string(seq);
+    auto it = m_lateParts.find(key);
+    bool late = it != m_lateParts.end() && it->second.erase(std::stoi(partId)) > 0;
+    if (late && it->second.empty())
+    {
+        m_lateParts.erase(it);
+    }
+    if (!late && !m_buffer.count(key) && !m_forwarded.count(key))
+    {
+        // A quorum the PS completed, or a retransmit after the AACK, must not take a new slot
+        auto seen = m_aackSeen.find(jobId);
+        late = seen != m_aackSeen.end() && (seq < seen->second.next || seen->second.above.count(seq));
+        if (late && m_resultCacheSize == 0)
+        {
+            // The PS tells late parts from duplicates and answers both
+            m_socket->SendTo(packet, 0, GetParameterServer(seq));
+            return true;
+        }
+        return false;
+    }
+    if (!late)
+    {
+        return false;
+    }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch late part " << partId << " of " << key
+                << (m_latePolicy == LATE_FOLD ? ", forwarding to PS" : ", dropped"));
+    if (m_latePolicy == LATE_FOLD)
+    {
+        m_socket->SendTo(packet, 0, GetParameterServer(seq));
+    }
+    if (m_stats)
+    {
+        m_stats->RecordLateContribution(std::stoul(jobId));
+    }
+    return true;
+}
+
+void
+AggregateSwitch::HandleMembership(const std::vector<std::string>& pktGradient, Address from)
+{
+    NS_LOG_FUNCTION(this << pktGradient[0] << from);
+    uint16_t jobId = std::stoi(pktGradient[1]);
+    uint16_t partId = std::stoi(pktGradient[2]);
+    if (pktGradient[0] == "LEAVE")
+    {
+        // A retransmitted LEAVE finds the part removed already and is answered again
+        RemoveMember(jobId, partId);
+        // Format : LEAVE,jobId,partId
+        SetFill("LEAVE," + pktGradient[1] + ',' + pktGradient[2]);
+        m_socket->SendTo(Create<Packet>(m_data, m_dataSize), 0, from);
+        return;
+    }
+
+    // A retransmitted JOIN gets the seq of the first one
+    AddMember(jobId, partId, GetJobFrontier(jobId));
+    uint32_t fromSeq = GetMembers(pktGradient[1])[partId];
+    auto ret = m_gackState.insert(std::make_pair(pktGradient[1] + ',' + pktGradient[2], GackState()));
+    ret.first->second.from = from;
+    if (ret.second)
+    {
+        ret.first->second.contiguous = static_cast<int64_t>(fromSeq) - 1;
+    }
+
+    // Format : JOIN,jobId,partId,fromSeq
+    SetFill("JOIN," + pktGradient[1] + ',' + pktGradient[2] + ',' + std::to_string(fromSeq));
+    m_socket->SendTo(Create<Packet>(m_data, m_dataSize), 0, from);
+}
+
+void
+AggregateSwitch::SendMembership(std::string jobId, std::string message)
+{
+    NS_LOG_FUNCTION(this << jobId << message);
+    if (m_protocol == PROTOCOL_SWITCHML)
+    {
+        return;     // Pool results go straight to the workers, there is no PS
+    }
+    // Change i of a job carries epoch i + 1, every shard applies them in order
+    MembershipLog& log = m_membershipLog[jobId];
+    log.changes.push_back(message + ',' + std::to_string(log.changes.size() + 1));
+    log.acked.resize(std::max<size_t>(1, m_shards.size()), 0);
+    ResendMembership(jobId);
+}
+
+void
+AggregateSwitch::ResendMembership(std::string jobId)
+{
+    NS_LOG_FUNCTION(this << jobId);
+    MembershipLog& log = m_membershipLog[jobId];
+    Simulator::Cancel(log.timer);
+    bool pending = false;
+    for (size_t shard = 0; shard < log.acked.size(); shard++)
+    {
+        Address dst = m_shards.empty() ? GetParameterServer(0) : m_shards[shard];
+        for (size_t i = log.acked[shard]; i < log.changes.size(); i++)
+        {
+            SetFill(log.changes[i]);
+            m_socket->SendTo(Create<Packet>(m_data, m_dataSize), 0, dst);
+            pending = true;
+        }
+    }
+    if (pending)
+    {
+        log.timer = Simulator::Schedule(m_membershipTimeout, &AggregateSwitch::ResendMembership, this, jobId);
+    }
+}
+
+void
+AggregateSwitch::HandleMembershipAck(const std::vector<std::string>& pktGradient, Address from)
+{
+    NS_LOG_FUNCTION(this << pktGradient[1] << from);
+    // Format : MACK,jobId,epoch with epoch the last change the shard applied
+    auto it = m_membershipLog.find(pktGradient[1]);
+    if (it == m_membershipLog.end())
+    {
+        return;
+    }
+    MembershipLog& log = it->second;
+    bool done = true;
+    for (size_t shard = 0; shard < log.acked.size(); shard++)
+    {
+        Address dst = m_shards.empty() ? GetParameterServer(0) : m_shards[shard];
+        if (dst == from)
+        {
+            log.acked[shard] = std::max<uint32_t>(log.acked[shard], std::stoul(pktGradient[2]));
+        }
+        done &= log.acked[shard] >= log.changes.size();
+    }
+    if (done)
+    {
+        Simulator::Cancel(log.timer);
+    }
+}
+
+bool
+AggregateSwitch::AnswerFromCache(std::string jobId, std::string partId, uint32_t seq, Address from)
+{
+    NS_LOG_FUNCTION(this << jobId << partId << seq << from);
+    std::string key = jobId + ',' + std::to_string(seq);
+    auto it = m_resultCache.find(key);
+    if (it != m_resultCache.end())
+    {
+        // Every part of the slot retransmits, one resend per round is enough
+        uint16_t part = std::stoi(partId);
+        CachedResult& cached = it->second;
+        if (cached.asked.empty() || cached.asked.count(part))
+        {
+            cached.asked.clear();
+            NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch resent cached result " << key);
+            m_socket->SendTo(Create<Packet>(cached.data.data(), cached.data.size()), 0, GetParameterServer(seq));
+        }
+        cached.asked.insert(part);
+        return true;
+    }
+
+    auto seen = m_aackSeen.find(jobId);
+    if (seen == m_aackSeen.end() || (seq >= seen->second.next && !seen->second.above.count(seq)))
+    {
+        return false;
+    }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch answered AACK " << key);
+    // Format : AACK,jobId,seq
+    SetFill("AACK," + jobId + ',' + std::to_string(seq));
+    m_socket->SendTo(Create<Packet>(m_data, m_dataSize), 0, from);
+    return true;
+}
+
+void
+AggregateSwitch::CacheResult(std::string key)
+{
+    NS_LOG_FUNCTION(this << key);
+    while (m_resultCache.size() >= m_resultCacheSize && !m_resultCacheOrder.empty())
+    {
+        // Oldest first, a retransmit of an evicted result is handled as if there was no cache
+        m_resultCache.erase(m_resultCacheOrder.front());
+        m_resultCacheOrder.pop_front();
+    }
+    m_resultCache[key].data.assign(m_data, m_data + m_dataSize);
+    m_resultCacheOrder.push_back(key);
+    m_resultCacheOccupancy = m_resultCache.size();
+}
+
+void
+AggregateSwitch::UpdateGack(std::string key, uint32_t seq, Address from, LatencyTag path, bool tagged)
+{
+    NS_LOG_FUNCTION(this << key << seq << from);
+    GackState& state = m_gackState[key];
+    state.from = from;
+    if (tagged)
+    {
+        state.path = path;
+        state.tagged = true;
+    }
+    if (seq > state.contiguous)
+    {
+        state.above.insert(seq);
+        // Advance the cumulative point over every seq that is now contiguous
+        while (!state.above.empty() && *state.above.begin() == state.contiguous + 1)
+        {
+            state.contiguous++;
+            state.above.erase(state.above.begin());
+        }
+    }
+    state.pending++;
+
+    if (state.pending >= m_gackBatchSize)
+    {
+        SendGack(key);
+    }
+    else if (!m_gackDelay.IsZero() && state.timer.IsExpired())
+    {
+        state.timer = Simulator::Schedule(m_gackDelay, &AggregateSwitch::SendGack, this, key);
+    }
+}
+
+void
+AggregateSwitch::SendGack(std::string key)
+{
+    NS_LOG_FUNCTION(this << key);
+    GackState& state = m_gackState[key];
+    Simulator::Cancel(state.timer);
+    state.pending = 0;
+    if (m_protocol != PROTOCOL_PA_ATP)
+    {
+        // Only the worker addresses are kept, AACKs are fanned out to them
+        return;
+    }
+
+    // Format : GACK,highestContiguousSeq,sackBitmap
+    // Bit i of the SACK bitmap marks seq ( highestContiguousSeq + 2 + i ) as received
+    std::set<uint16_t> sack;
+    for (uint32_t seq : state.above)
+    {
+        uint32_t offset = seq - state.contiguous - 2;
+        if (offset > UINT16_MAX)
+        {
+            break;
+        }
+        sack.insert(offset);
+    }
+    SetFill("GACK," + std::to_string(state.contiguous) + ',' + encode_bitmap(sack));
+    Ptr<Packet> pktGACK;
+    pktGACK = Create<Packet>(m_data, m_dataSize);
+    if (state.tagged)
+    {
+        pktGACK->AddPacketTag(state.path);
+        state.tagged = false;
+    }
+    m_socket->SendTo(pktGACK, 0, state.from);
+    if (m_eventTrace)
+    {
+        // Key format : jobId,partId
+        m_eventTrace->Record(EVENT_SWITCH_GACK, GetNode()->GetId(), std::stoi(key), state.contiguous, m_dataSize);
+    }
+
+    if (InetSocketAddress::IsMatchingType(state.from))
+    {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch sent GACK " << state.contiguous << " ( "
+                    << InetSocketAddress::ConvertFrom(state.from).GetIpv4() << " port "
+                    << InetSocketAddress::ConvertFrom(state.from).GetPort() << " )");
+    }
+}
+
+void
+AggregateSwitch::ForwardAack(Ptr<Packet> packet, std::string jobId)
+{
+    NS_LOG_FUNCTION(this << packet << jobId);
+    // Workers are keyed jobId,partId so the job's workers are one contiguous run
+    std::string prefix = jobId + ',';
+    for (auto it = m_gackState.lower_bound(prefix);
+         it != m_gackState.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it)
+    {
+        m_socket->SendTo(packet->Copy(), 0, it->second.from);
     }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " switch sent " << packet->GetSize() << " bytes to the workers of job "
+                << jobId);
 }
 
 } // Namespace ns3
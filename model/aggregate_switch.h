@@ -3,12 +3,22 @@
 
 #include "ns3/address.h"
 #include "ns3/application.h"
+#include "ns3/data-rate.h"
 #include "ns3/event-id.h"
+#include "ns3/nstime.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
+#include "ns3/aggregator.h"
+#include "ns3/latency_tag.h"
+#include "ns3/job_stats.h"
+#include "ns3/event_trace.h"
+#include "ns3/protocol_mode.h"
 
+#include <deque>
 #include <map>
 #include <set>
+#include <vector>
 
 namespace ns3
 {
@@ -16,6 +26,25 @@ namespace ns3
 class Socket;
 class Packet;
 
+/**
+ * How the switch locates the slot of a gradient.
+ */
+enum SlotIndex
+{
+    INDEX_ASSOCIATIVE, //!< Any free slot takes any gradient
+    INDEX_HASH,        //!< Gradients map to slots by hash ( jobId, seq )
+};
+
+/**
+ * What a hash indexed switch does when the slot of a new gradient is taken.
+ */
+enum CollisionPolicy
+{
+    COLLISION_FORWARD,      //!< Forward the gradient to the PS
+    COLLISION_LINEAR_PROBE, //!< Try the next ProbeLimit - 1 slots
+    COLLISION_MULTI_HASH,   //!< Try the slots of ProbeLimit independent hashes, cuckoo style
+};
+
 /**
  * \ingroup applications
  * \defgroup udpecho UdpEcho
@@ -42,9 +71,92 @@ class AggregateSwitch : public Application
     void SetRemote(Address ip, uint16_t port);
     void SetRemote(Address addr);
     void SetFill(std::string fill);
-    void SendResult();       // Send result to its destination
+    void SetFill(std::string fill, const std::vector<uint8_t>& payload);  // Header, terminator, then values
+    void SendResult(uint32_t seq);       // Send result to the PS shard owning seq
+
+    /**
+     * \brief Add a PS shard.
+     *
+     * Gradient seqs are split in ranges of ShardSize seqs assigned round robin
+     * over the shards in the order they are added. Without any shard every
+     * gradient goes to RemoteAddress.
+     *
+     * \param ip shard IP address
+     * \param port shard port
+     */
+    void AddParameterServer(Address ip, uint16_t port);
+
+    /**
+     * \brief Get the PS shard owning a gradient.
+     * \param seq gradient seq
+     * \return the shard socket address
+     */
+    Address GetParameterServer(uint32_t seq) const;
+
+    /**
+     * \brief Get the most aggregator memory in use at once so far.
+     * \return the high water mark in bytes
+     */
+    uint32_t GetMemoryHighWater() const;
+
+    /**
+     * \brief Get the parts a slot completes with.
+     * \return Quorum, or MaxParts when Quorum is zero or above it
+     */
+    uint16_t GetQuorum() const;
+
+    /**
+     * \brief Add a worker to a job from seq fromSeq on.
+     *
+     * The first change of a job turns its static fan-in into members
+     * 0 .. MaxParts - 1 from seq zero, from then on a seq completes with
+     * the members that joined at or before it. Adding a member twice keeps
+     * its first seq. The change is forwarded to every PS shard.
+     *
+     * \param jobId job id
+     * \param partId part of the worker
+     * \param fromSeq first seq the worker contributes to
+     */
+    void AddMember(uint16_t jobId, uint16_t partId, uint32_t fromSeq);
+
+    /**
+     * \brief Remove a worker from a job.
+     *
+     * In-flight slots of the job stop waiting for the worker and complete if
+     * the remaining members already contributed. Later gradients of the
+     * worker are dropped. The change is forwarded to every PS shard.
+     *
+     * \param jobId job id
+     * \param partId part of the worker
+     */
+    void RemoveMember(uint16_t jobId, uint16_t partId);
+
+    /**
+     * \brief Get the seq a worker joining a job now starts at.
+     * \param jobId job id
+     * \return the seq after the highest one received from the job
+     */
+    uint32_t GetJobFrontier(uint16_t jobId) const;
     ////////////////////////////////
 
+    /**
+     * Per-worker cumulative GACK state.
+     *
+     * The switch tracks every gradient seq it has received from a worker and
+     * acknowledges them with one GACK carrying the highest contiguous seq and a
+     * SACK bitmap of the seqs received beyond the first gap.
+     */
+    struct GackState
+    {
+        Address from;              //!< Worker address the GACK is returned to
+        int64_t contiguous = -1;   //!< Highest seq received with no gap below it
+        std::set<uint32_t> above;  //!< Seqs received beyond the first gap
+        uint32_t pending = 0;      //!< Gradients received since the last GACK
+        LatencyTag path;           //!< Path stamps of the last tagged gradient
+        bool tagged = false;       //!< Whether path holds stamps not returned yet
+        EventId timer;             //!< Delayed GACK event
+    };
+
   private:
     void StartApplication() override;
     void StopApplication() override;
@@ -58,6 +170,296 @@ class AggregateSwitch : public Application
      */
     void HandleRead(Ptr<Socket> socket);
 
+    /**
+     * \brief Get the time a packet spends in the switch pipeline.
+     *
+     * The packet waits for its ingress port, then takes one pass per
+     * ElementsPerPass gradient elements. Every pass adds PipelineLatency and
+     * holds the port for the packet size at PortProcessingRate.
+     *
+     * \param packet the received packet
+     * \return the delay until the packet is processed
+     */
+    Time GetPipelineDelay(Ptr<Packet> packet);
+
+    /**
+     * \brief Process a packet that has left the pipeline.
+     * \param packet the received packet
+     * \param from sender address
+     */
+    void Process(Ptr<Packet> packet, Address from);
+
+    /**
+     * \brief Record a received gradient and send a GACK if the policy allows.
+     * \param key worker key ( jobId,partId )
+     * \param seq gradient seq received
+     * \param from worker address
+     * \param path path stamps of the gradient
+     * \param tagged whether the gradient carried path stamps
+     */
+    void UpdateGack(std::string key, uint32_t seq, Address from, LatencyTag path, bool tagged);
+
+    /**
+     * \brief Send the cumulative GACK for one worker.
+     * \param key worker key ( jobId,partId )
+     */
+    void SendGack(std::string key);
+
+    /**
+     * \brief Replicate an AACK or a SwitchML result to every known worker of its job.
+     * \param packet AACK packet received from the PS, or result of a pool slot
+     * \param jobId job the packet belongs to
+     */
+    void ForwardAack(Ptr<Packet> packet, std::string jobId);
+
+    /**
+     * \brief Send a slot to the PS and free it.
+     * \param type RESULT for a complete slot, PARTIAL for a flushed one
+     * \param jobId job of the slot
+     * \param seq gradient seq of the slot
+     */
+    void SendSlot(std::string type, std::string jobId, std::string seq);
+
+    /**
+     * \brief Forward a gradient the switch cannot aggregate to the PS.
+     *
+     * Any partial aggregate already held for the gradient is flushed so the
+     * PS can complete it.
+     *
+     * \param packet the raw gradient packet
+     * \param jobId job of the gradient
+     * \param seq gradient seq
+     */
+    void FallBack(Ptr<Packet> packet, std::string jobId, std::string seq);
+
+    /**
+     * \brief Answer a retransmitted gradient from the result cache.
+     *
+     * A gradient whose result is cached means the result or its AACK was
+     * lost, the cached result is sent to the PS again. A gradient the switch
+     * has already seen AACKed means the worker lost the AACK, the switch
+     * returns one itself.
+     *
+     * \param jobId job of the gradient
+     * \param partId part of the gradient
+     * \param seq gradient seq
+     * \param from worker address
+     * \return true if the gradient was answered
+     */
+    bool AnswerFromCache(std::string jobId, std::string partId, uint32_t seq, Address from);
+
+    /**
+     * \brief Keep a result sent to the PS until its AACK passes the switch.
+     * \param key slot key ( jobId,seq )
+     */
+    void CacheResult(std::string key);
+
+    /**
+     * \brief Handle a contribution to a gradient that already completed with a quorum.
+     *
+     * Late parts are dropped, or forwarded to the PS with LatePolicy Fold.
+     *
+     * \param packet the raw gradient packet
+     * \param jobId job of the gradient
+     * \param partId part of the gradient
+     * \param seq gradient seq
+     * \return true if the contribution was late
+     */
+    bool HandleLate(Ptr<Packet> packet, std::string jobId, std::string partId, uint32_t seq);
+
+    /**
+     * \brief Handle a JOIN or LEAVE sent by a worker.
+     *
+     * A joining worker is answered with JOIN,jobId,partId,fromSeq and starts
+     * sending at fromSeq, the GACK state of the worker starts there too. A
+     * leaving worker is answered with LEAVE,jobId,partId, every time it asks.
+     *
+     * \param pktGradient the split packet header fields ( JOIN/LEAVE,jobId,partId )
+     * \param from worker address
+     */
+    void HandleMembership(const std::vector<std::string>& pktGradient, Address from);
+
+    /**
+     * \brief Send a membership change to every PS shard.
+     *
+     * The change gets the next epoch of its job and is resent every
+     * MembershipTimeout until every shard acknowledged it.
+     *
+     * \param jobId job of the change
+     * \param message JOIN,jobId,partId,fromSeq or LEAVE,jobId,partId
+     */
+    void SendMembership(std::string jobId, std::string message);
+
+    /**
+     * \brief Send every membership change of a job a shard has not acknowledged yet.
+     * \param jobId job of the changes
+     */
+    void ResendMembership(std::string jobId);
+
+    /**
+     * \brief Handle the MACK,jobId,epoch of a PS shard.
+     * \param pktGradient the split packet header fields
+     * \param from shard address
+     */
+    void HandleMembershipAck(const std::vector<std::string>& pktGradient, Address from);
+
+    /**
+     * \brief Get the member table of a job.
+     *
+     * A job without a table gets parts 0 .. MaxParts - 1 from seq zero, so
+     * its static workers stay members once the first change comes in.
+     *
+     * \param jobId job id
+     * \return the first seq of every member
+     */
+    std::map<uint16_t, uint32_t>& GetMembers(std::string jobId);
+
+    /**
+     * \brief Get the parts a seq of a job waits for.
+     * \param jobId job id
+     * \param seq gradient seq
+     * \return the members that joined at or before seq, or parts 0 .. MaxParts - 1
+     *         for a job without members
+     */
+    std::set<uint16_t> GetExpectedParts(std::string jobId, uint32_t seq) const;
+
+    /**
+     * \brief Check whether a slot has enough parts to complete.
+     *
+     * Only expected parts count, the slot completes with Quorum of them, or
+     * every one when there are fewer.
+     *
+     * \param jobId job of the slot
+     * \param seq gradient seq of the slot
+     * \param parts parts merged so far
+     * \return true if the slot is complete
+     */
+    bool IsComplete(std::string jobId, uint32_t seq, const std::set<uint16_t>& parts) const;
+
+    /**
+     * \brief Get the expected parts a slot completes with.
+     * \param jobId job of the slot
+     * \param seq gradient seq of the slot
+     * \return Quorum, or the expected part count when Quorum is zero or above it
+     */
+    uint16_t GetQuorum(std::string jobId, uint32_t seq) const;
+
+    /**
+     * \brief Check whether parts can arrive after the result of their gradient.
+     * \return true with a quorum below MaxParts or with elastic jobs
+     */
+    bool TracksLateParts() const;
+
+    /**
+     * \brief Find a free slot for a new gradient in the hash index.
+     *
+     * Candidates follow the collision policy. Each lookup is reported to the
+     * metrics collector, so collisions can be told apart per job.
+     *
+     * \param jobId job of the gradient
+     * \param seq gradient seq
+     * \param index the free slot found
+     * \param held filled with the keys of the slots holding the candidates, the preemption victims
+     * \return false if every candidate slot is taken
+     */
+    bool FindFreeIndex(std::string jobId, uint32_t seq, uint32_t& index, std::vector<std::string>& held);
+
+    /**
+     * \brief Get the priority of a job from its progress.
+     *
+     * The priority counts the slots the job completed, each decayed
+     * exponentially with ProgressWindow, so a job that stops completing
+     * gradients loses its priority.
+     *
+     * \param jobId job id
+     * \return the decayed count of completed slots
+     */
+    double GetJobPriority(std::string jobId) const;
+
+    /**
+     * \brief Flush the slot of a stalled or lower priority job to free room.
+     *
+     * A slot can be taken from another job that has been idle for
+     * PreemptIdleTime, or whose priority is below the one of the requesting
+     * job. The lowest priority candidate loses its slot, the least recently
+     * updated one on a tie. Its partial aggregate goes to the PS and its
+     * later parts follow, as after a fallback.
+     *
+     * \param jobId job that needs a slot
+     * \param candidates slot keys that may be preempted (empty considers every slot)
+     * \param index position of the preempted slot in the hash index
+     * \return false if no slot can be preempted
+     */
+    bool Preempt(std::string jobId, const std::vector<std::string>& candidates, uint32_t& index);
+
+    /**
+     * \brief Aggregate a gradient into its SwitchML pool slot.
+     *
+     * Seq s of a job always lands in slot s % SlotPoolSize. A worker only
+     * sends s once the result of s - SlotPoolSize is back, so a slot never
+     * holds two gradients and nothing overflows. A retransmit of the seq the
+     * slot completed last is answered from the shadow copy of its result,
+     * also while the slot already aggregates the next seq for the workers
+     * that did get the result.
+     *
+     * \param pktGradient the split packet header fields
+     * \param values the encoded values following the header
+     * \param valuesSize size of the encoded values
+     * \param from worker address
+     */
+    void AggregatePool(const std::vector<std::string>& pktGradient, const uint8_t* values, uint32_t valuesSize,
+                       Address from);
+
+    /**
+     * Aggregator slot of one gradient.
+     */
+    struct Slot
+    {
+        std::set<uint16_t> parts;     //!< Parts merged so far
+        std::vector<uint8_t> values;  //!< Aggregated values
+        std::string scale;            //!< Fixed point scale of the values
+        uint32_t memory = 0;          //!< Bytes charged to the memory budget
+        uint32_t index = 0;           //!< Position in the hash index
+        Time updated;                 //!< Last part merged
+    };
+
+    /**
+     * \brief Get the memory a slot takes.
+     *
+     * The values are striped over every pipeline stage, and every stage
+     * keeps SlotOverhead bytes of metadata (key, bitmap, counter) for it.
+     *
+     * \param valueBytes bytes of aggregated values the slot holds
+     * \return the bytes charged to the budget
+     */
+    uint32_t GetSlotMemory(uint32_t valueBytes) const;
+
+    /**
+     * \brief Charge a new slot to the memory budget.
+     * \param jobId job of the slot
+     * \param bytes slot memory
+     * \return false if MemoryBytes is set and the slot does not fit
+     */
+    bool AllocateMemory(std::string jobId, uint32_t bytes);
+
+    /**
+     * \brief Return the memory of a freed slot to the budget.
+     * \param jobId job of the slot
+     * \param bytes slot memory
+     */
+    void ReleaseMemory(std::string jobId, uint32_t bytes);
+
+    /**
+     * \brief Merge the values of one part into a slot.
+     * \param slot slot of the gradient
+     * \param fresh whether the part is the first one of the slot
+     * \param pktGradient the split packet header fields
+     * \param values the encoded values following the header
+     * \param valuesSize size of the encoded values
+     */
+    void MergeSlot(Slot& slot, bool fresh, const std::vector<std::string>& pktGradient, const uint8_t* values,
+                   uint32_t valuesSize);
+
     uint16_t m_port;       //!< Port to listen for incoming packets.
 
     uint8_t m_tos;         //!< The packets Type of Service
@@ -66,6 +468,8 @@ class AggregateSwitch : public Application
     Address m_local;       //!< local multicast address
     Address m_peerAddr; //!< Remote peer address
     uint16_t m_peerPort;   //!< Remote peer port
+    std::vector<Address> m_shards; //!< PS shard socket addresses
+    uint32_t m_shardSize;  //!< Consecutive seqs per shard range
 
     uint32_t m_size;
     uint32_t m_dataSize;
@@ -73,8 +477,119 @@ class AggregateSwitch : public Application
     uint32_t m_sent;       //!< Counter for sent packets
 
     uint16_t m_maxParts;
-    uint16_t m_bufferSize = 10;
-    std::map<std::string, std::set<uint16_t>> m_buffer;
+    uint16_t m_quorum;                //!< Parts a slot completes with (zero waits for MaxParts)
+    LatePolicy m_latePolicy;          //!< What happens to the parts arriving after a quorum result
+    std::map<std::string, std::set<uint16_t>> m_lateParts;   //!< Parts still due per quorum result, keyed jobId,seq
+    std::map<std::string, std::map<uint16_t, uint32_t>> m_members;   //!< First seq of every member of elastic jobs
+    std::map<std::string, uint32_t> m_jobFrontier;   //!< Seq after the highest one received per job
+
+    /**
+     * Membership changes of a job sent to the PS shards.
+     */
+    struct MembershipLog
+    {
+        std::vector<std::string> changes;   //!< Change i carries epoch i + 1
+        std::vector<uint32_t> acked;        //!< Last epoch each shard acknowledged
+        EventId timer;                      //!< Resend of the unacknowledged changes
+    };
+
+    Time m_membershipTimeout;         //!< Time before unacknowledged membership changes are resent
+    std::map<std::string, MembershipLog> m_membershipLog;   //!< Membership changes per job
+    uint32_t m_bufferSize;            //!< Slot budget when MemoryBytes is zero, size of the hash index
+    SlotIndex m_slotIndex;            //!< How gradients are mapped to slots
+    CollisionPolicy m_collisionPolicy;   //!< What a hash collision does
+    uint32_t m_probeLimit;            //!< Candidate slots tried per lookup
+    std::vector<std::string> m_index; //!< Key owning each hash index slot (empty is free)
+    uint64_t m_memoryBytes;           //!< Aggregator memory budget (zero budgets BufferSize slots)
+    uint32_t m_pipelineStages;        //!< Stages the budget and every slot are striped over
+    uint32_t m_slotOverhead;          //!< Metadata bytes of a slot in every stage
+    TracedValue<uint32_t> m_memoryOccupancy;   //!< Aggregator memory in use
+    TracedValue<uint32_t> m_memoryHighWater;   //!< Most aggregator memory in use at once
+    std::map<std::string, uint32_t> m_jobMemory;   //!< Aggregator memory in use per job
+
+    /**
+     * Progress of a job, the base of its preemption priority.
+     */
+    struct JobProgress
+    {
+        double completed = 0;         //!< Completed slots, decayed to updated
+        Time updated;                 //!< Last update of completed
+        Time active;                  //!< Last gradient received
+    };
+
+    bool m_preemption;                //!< Whether full switches take slots from stalled jobs
+    Time m_preemptIdleTime;           //!< Idle time after which any job can take the slots of a job
+    Time m_progressWindow;            //!< Decay time constant of the job priority
+    std::map<std::string, JobProgress> m_jobProgress;   //!< Progress per job
+
+    /**
+     * Lock step slot of the SwitchML pool.
+     */
+    struct PoolSlot
+    {
+        bool busy = false;            //!< Whether a gradient is aggregating in the slot
+        uint32_t seq = 0;             //!< Seq aggregating in the slot
+        uint32_t resultSeq = 0;       //!< Seq of the shadow copy in result
+        bool completed = false;       //!< Whether result holds the result of resultSeq
+        Slot slot;                    //!< Aggregation state of seq
+        uint32_t memory = 0;          //!< Bytes the slot holds for the whole run
+        std::vector<uint8_t> result;  //!< Shadow copy of the last result, resent on retransmits
+    };
+
+    /**
+     * \brief Send the result of a complete pool slot to the workers of its job.
+     * \param jobId job of the slot
+     * \param pool the slot, freed with its shadow copy kept
+     */
+    void CompletePool(std::string jobId, PoolSlot& pool);
+
+    ProtocolMode m_protocol;          //!< Aggregation protocol, PS relays and ATP sends no GACKs
+    std::map<std::string, Slot> m_buffer;
+    TracedValue<uint32_t> m_bufferOccupancy;  //!< Slots of m_buffer in use
+    AggregationDataType m_dataType;   //!< Element type of the gradient values
+    ReduceOp m_reduceOp;              //!< Reduction applied to the gradient values
+    Ptr<Aggregator> m_aggregator;     //!< Specialization for m_dataType and m_reduceOp
+    uint32_t m_sparseSlotElements;    //!< Dense elements a slot holds for sparse gradients
+    std::set<std::string> m_forwarded;   //!< Overflowed keys aggregated at the PS until AACKed
+
+    /**
+     * Result kept for retransmits until its AACK.
+     */
+    struct CachedResult
+    {
+        std::vector<uint8_t> data;    //!< RESULT packet as sent to the PS
+        std::set<uint16_t> asked;     //!< Parts that retransmitted since the last resend
+    };
+
+    /**
+     * Seqs of a job the switch has seen AACKed.
+     */
+    struct AackSeen
+    {
+        uint32_t next = 0;            //!< Lowest seq not AACKed yet
+        std::set<uint32_t> above;     //!< AACKed seqs beyond the first gap
+    };
+
+    uint32_t m_resultCacheSize;       //!< Results kept at once (zero disables the cache)
+    std::map<std::string, CachedResult> m_resultCache;   //!< Cached results keyed jobId,seq
+    std::deque<std::string> m_resultCacheOrder;          //!< Cache keys, oldest first
+    std::map<std::string, AackSeen> m_aackSeen;          //!< AACKed seqs per job, kept with the cache
+    TracedValue<uint32_t> m_resultCacheOccupancy;        //!< Results in the cache
+    uint32_t m_slotPool;              //!< SwitchML slots per job
+    std::map<std::string, PoolSlot> m_pool;   //!< SwitchML slots keyed jobId,index
+    Ptr<JobStats> m_stats;            //!< Metrics collector (may be null)
+    Ptr<EventTrace> m_eventTrace;     //!< Binary event log (may be null)
+
+    Time m_pipelineLatency;           //!< Latency of one pipeline pass
+    uint32_t m_elementsPerPass;       //!< Elements aggregated per pass (zero is unlimited)
+    DataRate m_portRate;              //!< Processing rate per ingress port (zero is unlimited)
+    std::map<uint32_t, Time> m_portBusyUntil;   //!< Time each ingress port finishes its queued passes
+    std::deque<EventId> m_processEvents;        //!< Packets still in the pipeline, in arrival order
+    TracedValue<uint32_t> m_recirculations;     //!< Extra passes taken so far
+
+    uint32_t m_gackBatchSize;     //!< Gradients acknowledged per GACK
+    Time m_gackDelay;             //!< Max time a GACK is held back (zero disables the timer)
+    std::map<std::string, GackState> m_gackState;   //!< GACK state per worker
 
     /// Callbacks for tracing the packet Fw events
     TracedCallback<Ptr<const Packet>> m_fwTrace;
@@ -0,0 +1,131 @@
+#include "aggregator.h"
+
+#include "ns3/fatal-error.h"
+
+namespace ns3
+{
+
+float
+HalfToFloat(uint16_t bits)
+{
+    uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1f;
+    uint32_t mantissa = bits & 0x3ff;
+    uint32_t result;
+    if (exponent == 0x1f)
+    {
+        // Inf / NaN
+        result = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        result = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        result = sign;
+    }
+    else
+    {
+        // Subnormal half, normalize it
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        result = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &result, sizeof(f));
+    return f;
+}
+
+uint16_t
+FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 112;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        // Inf / NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 0x1f)
+    {
+        // Overflow saturates to infinity
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return sign;
+        }
+        // Subnormal half
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1)))
+        {
+            half++;
+        }
+        return sign | half;
+    }
+    uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    {
+        // Round to nearest even, a carry into the exponent is still correct
+        half++;
+    }
+    return half;
+}
+
+/**
+ * \brief Create the aggregator of one element type for a reduction.
+ * \param op reduction
+ * \return the aggregator
+ */
+template <typename T>
+static Ptr<Aggregator>
+CreateTypedAggregator(ReduceOp op)
+{
+    switch (op)
+    {
+    case REDUCE_SUM:
+        return Create<TypedAggregator<T, SumOp>>();
+    case REDUCE_MAX:
+        return Create<TypedAggregator<T, MaxOp>>();
+    case REDUCE_MIN:
+        return Create<TypedAggregator<T, MinOp>>();
+    }
+    NS_FATAL_ERROR("Unknown reduce op " << op);
+    return nullptr;
+}
+
+Ptr<Aggregator>
+CreateAggregator(AggregationDataType type, ReduceOp op)
+{
+    switch (type)
+    {
+    case INT32:
+        return CreateTypedAggregator<int32_t>(op);
+    case FLOAT32:
+        return CreateTypedAggregator<float>(op);
+    case FLOAT16:
+        return CreateTypedAggregator<Float16>(op);
+    case BFLOAT16:
+        return CreateTypedAggregator<BFloat16>(op);
+    }
+    NS_FATAL_ERROR("Unknown aggregation data type " << type);
+    return nullptr;
+}
+
+} // namespace ns3
@@ -0,0 +1,391 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+
+namespace ns3
+{
+
+/**
+ * Element type of the values carried in gradient packets.
+ */
+enum AggregationDataType
+{
+    INT32,    //!< Fixed point, quantized by the worker (what switches aggregate)
+    FLOAT32,  //!< IEEE single precision
+    FLOAT16,  //!< IEEE half precision
+    BFLOAT16, //!< Brain floating point
+};
+
+/**
+ * Reduction applied element wise to the contributions of one gradient.
+ */
+enum ReduceOp
+{
+    REDUCE_SUM,
+    REDUCE_MAX,
+    REDUCE_MIN,
+};
+
+/**
+ * \brief IEEE half precision storage type.
+ */
+struct Float16
+{
+    uint16_t bits;
+};
+
+/**
+ * \brief Brain floating point storage type (upper half of a float32).
+ */
+struct BFloat16
+{
+    uint16_t bits;
+};
+
+float HalfToFloat(uint16_t bits);
+uint16_t FloatToHalf(float value);
+
+/**
+ * \brief Conversion and arithmetic of one element type.
+ *
+ * Narrow floating point types are widened to float for arithmetic and
+ * rounded back, which is what fp16/bf16 accumulation does in hardware.
+ */
+template <typename T>
+struct ElementTraits
+{
+    static double ToDouble(T v)
+    {
+        return v;
+    }
+
+    static T FromDouble(double v)
+    {
+        return static_cast<T>(v);
+    }
+
+    static T Add(T a, T b)
+    {
+        return a + b;
+    }
+
+    static bool Less(T a, T b)
+    {
+        return a < b;
+    }
+};
+
+template <>
+struct ElementTraits<int32_t>
+{
+    static double ToDouble(int32_t v)
+    {
+        return v;
+    }
+
+    static int32_t FromDouble(double v)
+    {
+        v = std::round(v);
+        v = std::min<double>(v, std::numeric_limits<int32_t>::max());
+        v = std::max<double>(v, std::numeric_limits<int32_t>::min());
+        return static_cast<int32_t>(v);
+    }
+
+    static int32_t Add(int32_t a, int32_t b)
+    {
+        // Saturate instead of wrapping like a switch ALU with overflow detection
+        int64_t sum = static_cast<int64_t>(a) + b;
+        sum = std::min<int64_t>(sum, std::numeric_limits<int32_t>::max());
+        sum = std::max<int64_t>(sum, std::numeric_limits<int32_t>::min());
+        return static_cast<int32_t>(sum);
+    }
+
+    static bool Less(int32_t a, int32_t b)
+    {
+        return a < b;
+    }
+};
+
+template <>
+struct ElementTraits<Float16>
+{
+    static double ToDouble(Float16 v)
+    {
+        return HalfToFloat(v.bits);
+    }
+
+    static Float16 FromDouble(double v)
+    {
+        return Float16{FloatToHalf(static_cast<float>(v))};
+    }
+
+    static Float16 Add(Float16 a, Float16 b)
+    {
+        return Float16{FloatToHalf(HalfToFloat(a.bits) + HalfToFloat(b.bits))};
+    }
+
+    static bool Less(Float16 a, Float16 b)
+    {
+        return HalfToFloat(a.bits) < HalfToFloat(b.bits);
+    }
+};
+
+template <>
+struct ElementTraits<BFloat16>
+{
+    static float ToFloat(BFloat16 v)
+    {
+        uint32_t bits = static_cast<uint32_t>(v.bits) << 16;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static BFloat16 FromFloat(float f)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        // Round to nearest even on the dropped half
+        bits += 0x7fff + ((bits >> 16) & 1);
+        return BFloat16{static_cast<uint16_t>(bits >> 16)};
+    }
+
+    static double ToDouble(BFloat16 v)
+    {
+        return ToFloat(v);
+    }
+
+    static BFloat16 FromDouble(double v)
+    {
+        return FromFloat(static_cast<float>(v));
+    }
+
+    static BFloat16 Add(BFloat16 a, BFloat16 b)
+    {
+        return FromFloat(ToFloat(a) + ToFloat(b));
+    }
+
+    static bool Less(BFloat16 a, BFloat16 b)
+    {
+        return ToFloat(a) < ToFloat(b);
+    }
+};
+
+/// Element wise sum
+struct SumOp
+{
+    template <typename T>
+    static T Apply(T a, T b)
+    {
+        return ElementTraits<T>::Add(a, b);
+    }
+};
+
+/// Element wise maximum
+struct MaxOp
+{
+    template <typename T>
+    static T Apply(T a, T b)
+    {
+        return ElementTraits<T>::Less(a, b) ? b : a;
+    }
+};
+
+/// Element wise minimum
+struct MinOp
+{
+    template <typename T>
+    static T Apply(T a, T b)
+    {
+        return ElementTraits<T>::Less(b, a) ? b : a;
+    }
+};
+
+/**
+ * \brief Reduces gradient payloads of one element type.
+ *
+ * Payloads are raw little endian element arrays. The element type and the
+ * reduction are fixed when the aggregator is created, so selecting them costs
+ * one virtual call per packet rather than a branch per element.
+ */
+class Aggregator : public SimpleRefCount<Aggregator>
+{
+  public:
+    virtual ~Aggregator() = default;
+
+    /**
+     * \return the size in bytes of one element
+     */
+    virtual uint32_t GetElementSize() const = 0;
+
+    /**
+     * \brief Reduce a contribution into an accumulator, acc[i] = op(acc[i], in[i]).
+     * \param acc accumulator payload
+     * \param in contribution payload
+     * \param count number of elements
+     */
+    virtual void Merge(uint8_t* acc, const uint8_t* in, uint32_t count) const = 0;
+
+    /**
+     * \brief Multiply every element of a payload by factor, moving it to another scale.
+     *
+     * Fixed point payloads quantized with different scales must be aligned on
+     * the smaller one before they are merged.
+     *
+     * \param payload payload rescaled in place
+     * \param count number of elements
+     * \param factor ratio of the new scale to the current one
+     */
+    virtual void Rescale(uint8_t* payload, uint32_t count, double factor) const = 0;
+
+    /**
+     * \brief Reduce sparse ( index, value ) pairs into a dense accumulator.
+     *
+     * Each pair is a uint32_t index followed by one element. Absent indices
+     * are left untouched, i.e. they count as zero for a sum.
+     *
+     * \param acc dense accumulator payload
+     * \param pairs sparse contribution payload
+     * \param count number of pairs
+     */
+    virtual void MergeSparse(uint8_t* acc, const uint8_t* pairs, uint32_t count) const = 0;
+
+    /**
+     * \brief Decode a payload, dividing every element by scale.
+     * \param in payload
+     * \param count number of elements
+     * \param scale fixed point scale of the payload (1 for floating point types)
+     * \param out decoded values
+     */
+    virtual void Decode(const uint8_t* in, uint32_t count, double scale, double* out) const = 0;
+
+    /**
+     * \brief Encode values into a payload, multiplying every element by scale.
+     * \param in values
+     * \param count number of elements
+     * \param scale fixed point scale of the payload (1 for floating point types)
+     * \param out payload
+     */
+    virtual void Encode(const double* in, uint32_t count, double scale, uint8_t* out) const = 0;
+
+    /**
+     * \brief Encode ( index, value ) pairs into a sparse payload.
+     * \param index element indices
+     * \param in values
+     * \param count number of pairs
+     * \param scale fixed point scale of the payload (1 for floating point types)
+     * \param out payload of count * ( 4 + element size ) bytes
+     */
+    virtual void EncodeSparse(const uint32_t* index,
+                              const double* in,
+                              uint32_t count,
+                              double scale,
+                              uint8_t* out) const = 0;
+};
+
+/**
+ * \brief Aggregator specialized on its element type and reduction.
+ */
+template <typename T, typename Op>
+class TypedAggregator : public Aggregator
+{
+  public:
+    uint32_t GetElementSize() const override
+    {
+        return sizeof(T);
+    }
+
+    void Merge(uint8_t* acc, const uint8_t* in, uint32_t count) const override
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T a;
+            T b;
+            std::memcpy(&a, acc + i * sizeof(T), sizeof(T));
+            std::memcpy(&b, in + i * sizeof(T), sizeof(T));
+            a = Op::Apply(a, b);
+            std::memcpy(acc + i * sizeof(T), &a, sizeof(T));
+        }
+    }
+
+    void Rescale(uint8_t* payload, uint32_t count, double factor) const override
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T v;
+            std::memcpy(&v, payload + i * sizeof(T), sizeof(T));
+            v = ElementTraits<T>::FromDouble(ElementTraits<T>::ToDouble(v) * factor);
+            std::memcpy(payload + i * sizeof(T), &v, sizeof(T));
+        }
+    }
+
+    void MergeSparse(uint8_t* acc, const uint8_t* pairs, uint32_t count) const override
+    {
+        const uint32_t pairSize = sizeof(uint32_t) + sizeof(T);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t index;
+            T a;
+            T b;
+            std::memcpy(&index, pairs + i * pairSize, sizeof(uint32_t));
+            std::memcpy(&b, pairs + i * pairSize + sizeof(uint32_t), sizeof(T));
+            std::memcpy(&a, acc + index * sizeof(T), sizeof(T));
+            a = Op::Apply(a, b);
+            std::memcpy(acc + index * sizeof(T), &a, sizeof(T));
+        }
+    }
+
+    void Decode(const uint8_t* in, uint32_t count, double scale, double* out) const override
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T v;
+            std::memcpy(&v, in + i * sizeof(T), sizeof(T));
+            out[i] = ElementTraits<T>::ToDouble(v) / scale;
+        }
+    }
+
+    void Encode(const double* in, uint32_t count, double scale, uint8_t* out) const override
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T v = ElementTraits<T>::FromDouble(in[i] * scale);
+            std::memcpy(out + i * sizeof(T), &v, sizeof(T));
+        }
+    }
+
+    void EncodeSparse(const uint32_t* index,
+                      const double* in,
+                      uint32_t count,
+                      double scale,
+                      uint8_t* out) const override
+    {
+        const uint32_t pairSize = sizeof(uint32_t) + sizeof(T);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T v = ElementTraits<T>::FromDouble(in[i] * scale);
+            std::memcpy(out + i * pairSize, &index[i], sizeof(uint32_t));
+            std::memcpy(out + i * pairSize + sizeof(uint32_t), &v, sizeof(T));
+        }
+    }
+};
+
+/**
+ * \brief Create the aggregator specialization for a data type and reduction.
+ * \param type element type
+ * \param op reduction
+ * \return the aggregator
+ */
+Ptr<Aggregator> CreateAggregator(AggregationDataType type, ReduceOp op);
+
+} // namespace ns3
+
+#endif /* AGGREGATOR_H */
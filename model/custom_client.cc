@@ -1,6 +1,7 @@
 #include "custom_client.h"
 
 #include "ns3/address-utils.h"
+#include "ns3/boolean.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/ipv4-address.h"
@@ -14,9 +15,16 @@
 #include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 #include "ns3/udp-socket.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/pointer.h"
+#include "ns3/string.h"
 
 #include <sstream>
 #include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
 #include "ns3/my_utils.h"
 
 namespace ns3
@@ -35,20 +43,87 @@ CustomClient::GetTypeId()
             .SetGroupName("Applications")
             .AddConstructor<CustomClient>()
             .AddAttribute("MaxPackets",
-                          "The maximum number of packets the application will send (zero means infinite)",
+                          "The maximum number of packets the application will send (zero means infinite), "
+                          "a Model sends every packet of its Iterations instead",
                           UintegerValue(100),
                           MakeUintegerAccessor(&CustomClient::m_count),
                           MakeUintegerChecker<uint32_t>())
             .AddAttribute("Interval",
-                          "The time to wait between packets",
+                          "The time to wait between packets, unused when a GradientTrace or Model releases them",
                           TimeValue(Seconds(1.0)),
                           MakeTimeAccessor(&CustomClient::m_interval),
                           MakeTimeChecker())
+            .AddAttribute("PacingFraction",
+                          "Share of the link rate a token bucket paces the gradients at, it replaces "
+                          "the Interval spacing (zero disables pacing)",
+                          DoubleValue(0),
+                          MakeDoubleAccessor(&CustomClient::m_pacingFraction),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("PacingBurst",
+                          "Token bucket size in bytes, rounded up to one packet",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&CustomClient::m_pacingBurst),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("Protocol",
+                          "Aggregation protocol of the job. PS and ATP send within the AACK window only, "
+                          "PA-ATP also within the GACK window, SwitchML into the slot pool in lock step",
+                          EnumValue(PROTOCOL_PA_ATP),
+                          MakeEnumAccessor<ProtocolMode>(&CustomClient::m_protocol),
+                          MakeEnumChecker(PROTOCOL_PS, "PS",
+                                          PROTOCOL_ATP, "ATP",
+                                          PROTOCOL_PA_ATP, "PA-ATP",
+                                          PROTOCOL_SWITCHML, "SwitchML"))
+            .AddAttribute("SlotPoolSize",
+                          "Switch slots of the job in SwitchML mode, seq s reuses the slot of "
+                          "seq s - SlotPoolSize once its result is back",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&CustomClient::m_slotPool),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("RetransmitTimeout",
+                          "Time without GACK progress before unacknowledged gradients are "
+                          "retransmitted (zero disables retransmission)",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CustomClient::m_rto),
+                          MakeTimeChecker())
+            .AddAttribute("AackTimeout",
+                          "Time without AACK progress before GACKed gradients are retransmitted "
+                          "to recover a lost result or AACK (zero disables it)",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CustomClient::m_aackTimeout),
+                          MakeTimeChecker())
             .AddAttribute("Port",
                           "Port for receiving packets",
                           UintegerValue(1),
                           MakeUintegerAccessor(&CustomClient::m_port),
                           MakeUintegerChecker<uint16_t>())
+            .AddAttribute("GradientTrace",
+                          "Gradient emission trace the worker replays instead of sending every "
+                          "Interval. Each record releases its bytes split into PacketSize packets.",
+                          PointerValue(),
+                          MakePointerAccessor(&CustomClient::m_gradientTrace),
+                          MakePointerChecker<GradientTrace>())
+            .AddAttribute("Model",
+                          "Model profile the worker trains (ResNet-50, VGG-16, BERT-Base, GPT-2). "
+                          "Each layer releases its gradient, split into PacketSize packets, when its "
+                          "backward compute finishes. An iteration starts once the previous one is AACKed.",
+                          StringValue(""),
+                          MakeStringAccessor(&CustomClient::m_modelName),
+                          MakeStringChecker())
+            .AddAttribute("Iterations",
+                          "Number of training iterations of the model profile",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&CustomClient::m_iterations),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ComputeScale",
+                          "Factor applied to the compute times of the model profile",
+                          DoubleValue(1.0),
+                          MakeDoubleAccessor(&CustomClient::m_computeScale),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("EventTrace",
+                          "Binary event log the worker records to",
+                          PointerValue(),
+                          MakePointerAccessor(&CustomClient::m_eventTrace),
+                          MakePointerChecker<EventTrace>())
             .AddAttribute("RemoteAddress",
                           "The destination Address of the outbound packets",
                           AddressValue(),
@@ -65,6 +140,14 @@ CustomClient::GetTypeId()
                           UintegerValue(0),
                           MakeUintegerAccessor(&CustomClient::m_tos),
                           MakeUintegerChecker<uint8_t>())
+            .AddAttribute("ProgressTos",
+                          "TOS of each progress class, comma separated from the lagging to the "
+                          "leading class. The AACKed share of MaxPackets picks the class of every "
+                          "packet, so priority queues can serve lagging jobs first (empty sends "
+                          "every packet with Tos)",
+                          StringValue(""),
+                          MakeStringAccessor(&CustomClient::m_progressTosList),
+                          MakeStringChecker())
             .AddAttribute("PacketSize",
                           "Size of echo data in outbound packets",
                           UintegerValue(100),
@@ -80,6 +163,78 @@ CustomClient::GetTypeId()
                           UintegerValue(0),
                           MakeUintegerAccessor(&CustomClient::m_partId),
                           MakeUintegerChecker<uint16_t>())
+            .AddAttribute("Elastic",
+                          "Whether the worker joins its job through the switch on start and leaves it "
+                          "on stop. It sends from the seq the switch returns instead of zero.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CustomClient::m_elastic),
+                          MakeBooleanChecker())
+            .AddAttribute("JoinTimeout",
+                          "Time before an unanswered JOIN or LEAVE of an Elastic worker is resent",
+                          TimeValue(MilliSeconds(10)),
+                          MakeTimeAccessor(&CustomClient::m_joinTimeout),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("Elements",
+                          "Number of gradient values carried per packet (zero sends no values)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&CustomClient::m_elements),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("DataType",
+                          "Element type the gradient values are encoded in",
+                          EnumValue(INT32),
+                          MakeEnumAccessor<AggregationDataType>(&CustomClient::m_dataType),
+                          MakeEnumChecker(INT32, "Int32",
+                                          FLOAT32, "Float32",
+                                          FLOAT16, "Float16",
+                                          BFLOAT16, "BFloat16"))
+            .AddAttribute("FixedPointHeadroom",
+                          "Contributions an Int32 sum must hold without saturating. Each packet is "
+                          "quantized with the largest power of two scale keeping Headroom times its "
+                          "largest magnitude value in range",
+                          UintegerValue(64),
+                          MakeUintegerAccessor(&CustomClient::m_fixedPointHeadroom),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("TopK",
+                          "Number of largest magnitude values sent as ( index, value ) pairs "
+                          "out of Elements, the switch and PS must reduce with Sum (zero sends dense values)",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&CustomClient::m_topK),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("InitialCongestionWindow",
+                          "Gradients the worker may initially send beyond the last GACK",
+                          UintegerValue(5),
+                          MakeUintegerAccessor(&CustomClient::m_initialCwd),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("InitialAggregationWindow",
+                          "Gradients the worker may initially send beyond the last AACK",
+                          UintegerValue(15),
+                          MakeUintegerAccessor(&CustomClient::m_initialAwd),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("Stats",
+                          "Metrics collector the worker reports to",
+                          PointerValue(),
+                          MakePointerAccessor(&CustomClient::m_stats),
+                          MakePointerChecker<JobStats>())
+            .AddTraceSource("CongestionWindow",
+                            "Current congestion window of the worker",
+                            MakeTraceSourceAccessor(&CustomClient::m_CWD),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("AggregationWindow",
+                            "Current aggregation window of the worker",
+                            MakeTraceSourceAccessor(&CustomClient::m_AWD),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("LastGack",
+                            "Highest gradient seq cumulatively acknowledged by a GACK",
+                            MakeTraceSourceAccessor(&CustomClient::m_lastGACK),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("LastAack",
+                            "Highest gradient seq cumulatively acknowledged by an AACK",
+                            MakeTraceSourceAccessor(&CustomClient::m_lastAACK),
+                            "ns3::TracedValueCallback::Uint32")
+            .AddTraceSource("LatencyBreakdown",
+                            "Per stage latency of a gradient, reported on its AACK",
+                            MakeTraceSourceAccessor(&CustomClient::m_latencyTrace),
+                            "ns3::CustomClient::LatencyTracedCallback")
             .AddTraceSource("Tx",
                             "A new packet is created and is sent",
                             MakeTraceSourceAccessor(&CustomClient::m_txTrace),
@@ -109,8 +264,19 @@ CustomClient::CustomClient()
     m_dataSize = 0;
     m_lastAACK = 0;
     m_lastGACK = 0;
-    m_AWD = 15;
-    m_CWD = 5;
+    m_AWD = 0;
+    m_CWD = 0;
+    m_retransmits = 0;
+    m_aackNext = 0;
+    m_startSeq = 0;
+    m_traceCursor = 0;
+    m_released = 0;
+    m_tracePacketSize = 0;
+    m_model = nullptr;
+    m_iteration = 0;
+    m_backwardDone = false;
+    m_joined = false;
+    m_leaving = false;
 }
 
 CustomClient::~CustomClient()
@@ -143,6 +309,27 @@ CustomClient::StartApplication()
 {
     NS_LOG_FUNCTION(this);
 
+    m_aggregator = CreateAggregator(m_dataType, REDUCE_SUM);
+    m_AWD = m_initialAwd;
+    m_CWD = m_initialCwd;
+    m_pacingRate = DataRate(0);
+    if (m_pacingFraction > 0) {
+        // The first device with a DataRate is the NIC, the loopback has none
+        for (uint32_t i = 0; i < GetNode()->GetNDevices(); i++) {
+            DataRateValue linkRate;
+            if (GetNode()->GetDevice(i)->GetAttributeFailSafe("DataRate", linkRate)) {
+                m_pacingRate = DataRate(linkRate.Get().GetBitRate() * m_pacingFraction);
+                break;
+            }
+        }
+    }
+    m_tokens = std::max(m_pacingBurst, m_size);
+    m_tokensUpdated = Simulator::Now();
+    m_progressTos.clear();
+    for (const std::string& tos : split_string(m_progressTosList, (char *)",")) {
+        m_progressTos.push_back(std::stoul(tos, nullptr, 0));
+    }
+
     if (!m_socket)
     {
         TypeId tid = TypeId::LookupByName("ns3::UdpSocketFactory");
@@ -176,7 +363,51 @@ CustomClient::StartApplication()
 
     m_socket->SetRecvCallback(MakeCallback(&CustomClient::HandleRead, this));
     m_socket->SetAllowBroadcast(true);
-    if (m_sent < m_count) {
+    m_model = nullptr;
+    if (!m_modelName.empty()) {
+        m_model = GetModelProfile(m_modelName);
+        NS_ABORT_MSG_IF(!m_model, "Unknown model profile " << m_modelName);
+    }
+    if (m_elastic) {
+        m_joined = false;
+        SendJoin();
+    }
+    else {
+        StartSending(0);
+    }
+}
+
+void
+CustomClient::StartSending(uint32_t fromSeq)
+{
+    NS_LOG_FUNCTION(this << fromSeq);
+    m_sent = fromSeq;
+    m_aackNext = fromSeq;
+    m_startSeq = fromSeq;
+    m_lastAACK = fromSeq > 0 ? fromSeq - 1 : 0;
+    m_lastGACK = fromSeq > 0 ? fromSeq - 1 : 0;
+    if (m_gradientTrace || m_model) {
+        m_traceCursor = 0;
+        m_released = fromSeq;
+        m_tracePacketSize = m_size;
+        m_traceStart = Simulator::Now();
+    }
+    if (m_model) {
+        // The job is every layer of every iteration, split the way ReleaseBytes splits them
+        uint32_t packets = 0;
+        for (const LayerProfile& layer : m_model->layers) {
+            packets += std::max<uint64_t>(1, (layer.bytes + m_tracePacketSize - 1) / m_tracePacketSize);
+        }
+        m_count = fromSeq + packets * m_iterations;
+    }
+    if (m_gradientTrace) {
+        ScheduleRelease();
+    }
+    else if (m_model) {
+        m_iteration = 0;
+        StartIteration();
+    }
+    if (CanSend()) {
         ScheduleTransmit(Seconds(0.));
     }
 }
@@ -186,14 +417,55 @@ CustomClient::StopApplication()
 {
     NS_LOG_FUNCTION(this);
 
+    Simulator::Cancel(m_sendEvent);
+    Simulator::Cancel(m_rtoEvent);
+    Simulator::Cancel(m_aackEvent);
+    Simulator::Cancel(m_releaseEvent);
+    Simulator::Cancel(m_joinEvent);
+
+    if (m_socket && m_joined)
+    {
+        // The socket stays open until the switch answers the LEAVE
+        m_joined = false;
+        m_leaving = true;
+        SendLeave();
+        return;
+    }
+    CloseSocket();
+}
+
+void
+CustomClient::CloseSocket()
+{
+    NS_LOG_FUNCTION(this);
     if (m_socket)
     {
         m_socket->Close();
         m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
         m_socket = nullptr;
     }
+}
 
-    Simulator::Cancel(m_sendEvent);
+void
+CustomClient::SendJoin()
+{
+    NS_LOG_FUNCTION(this);
+    // Format : JOIN,jobId,partId, sent without SetFill so PacketSize is kept for the gradients
+    std::string join = "JOIN," + std::to_string(m_jobId) + ',' + std::to_string(m_partId);
+    m_socket->Send(Create<Packet>(reinterpret_cast<const uint8_t*>(join.c_str()), join.size() + 1));
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId << " ) sent JOIN");
+    m_joinEvent = Simulator::Schedule(m_joinTimeout, &CustomClient::SendJoin, this);
+}
+
+void
+CustomClient::SendLeave()
+{
+    NS_LOG_FUNCTION(this);
+    // Format : LEAVE,jobId,partId
+    std::string leave = "LEAVE," + std::to_string(m_jobId) + ',' + std::to_string(m_partId);
+    m_socket->Send(Create<Packet>(reinterpret_cast<const uint8_t*>(leave.c_str()), leave.size() + 1));
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId << " ) sent LEAVE");
+    m_joinEvent = Simulator::Schedule(m_joinTimeout, &CustomClient::SendLeave, this);
 }
 
 void
@@ -306,6 +578,99 @@ CustomClient::ScheduleTransmit(Time dt)
     m_sendEvent = Simulator::Schedule(dt, &CustomClient::Send, this);
 }
 
+bool
+CustomClient::CanSend() const
+{
+    uint32_t boundary = m_lastAACK + m_AWD;
+    if (m_protocol == PROTOCOL_PA_ATP) {
+        boundary = std::min<uint32_t>(boundary, m_lastGACK + m_CWD);
+    }
+    if ((m_gradientTrace || m_model) && m_sent >= m_released) {
+        return false;   // Waiting for the trace or the model to release the next gradient
+    }
+    if (m_protocol == PROTOCOL_SWITCHML) {
+        // Lock step, the slot of m_sent is free once the result of its previous use is back
+        uint32_t previous = m_sent - m_slotPool;
+        return m_sent < m_count &&
+               (m_sent < m_slotPool || previous < m_aackNext || m_aackAbove.count(previous));
+    }
+    return m_sent < m_count && m_sent <= boundary;    // m_sent = next to send, so within boundary is ok
+}
+
+void
+CustomClient::ScheduleRelease()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_gradientTrace->FindNext(m_jobId, m_partId, m_traceCursor)) {
+        return;
+    }
+    const GradientTraceRecord& record = m_gradientTrace->GetRecord(m_traceCursor);
+    Time release = m_traceStart + NanoSeconds(record.time);
+    m_releaseEvent = Simulator::Schedule(std::max(release - Simulator::Now(), Seconds(0)), &CustomClient::Release, this);
+}
+
+void
+CustomClient::Release()
+{
+    NS_LOG_FUNCTION(this);
+    const GradientTraceRecord& record = m_gradientTrace->GetRecord(m_traceCursor);
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId << " ) released tensor "
+                << record.tensor << " ( " << record.bytes << " bytes )");
+    m_traceCursor++;
+    ScheduleRelease();
+    ReleaseBytes(record.bytes);
+}
+
+void
+CustomClient::ReleaseBytes(uint64_t bytes)
+{
+    NS_LOG_FUNCTION(this << bytes);
+    m_released += std::max<uint64_t>(1, (bytes + m_tracePacketSize - 1) / m_tracePacketSize);
+
+    if (m_sendEvent.IsExpired() && CanSend()) {
+        ScheduleTransmit(Seconds(0.));
+    }
+}
+
+void
+CustomClient::StartIteration()
+{
+    NS_LOG_FUNCTION(this << m_iteration);
+    m_backwardDone = false;
+    // Backward starts from the output layer once the forward pass is done
+    uint32_t last = m_model->layers.size() - 1;
+    Time compute = m_model->forward + m_model->layers[last].backward;
+    m_releaseEvent = Simulator::Schedule(compute * m_computeScale, &CustomClient::Backward, this, last);
+}
+
+void
+CustomClient::Backward(uint32_t layer)
+{
+    NS_LOG_FUNCTION(this << layer);
+    const LayerProfile& profile = m_model->layers[layer];
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId << " ) iteration "
+                << m_iteration << " released " << profile.name << " ( " << profile.bytes << " bytes )");
+    if (layer > 0) {
+        m_releaseEvent = Simulator::Schedule(m_model->layers[layer - 1].backward * m_computeScale,
+                                             &CustomClient::Backward, this, layer - 1);
+    }
+    else {
+        m_backwardDone = true;
+    }
+    ReleaseBytes(profile.bytes);
+}
+
+void
+CustomClient::CheckIteration()
+{
+    // Synchronous training, the next forward pass needs the aggregated update of every layer
+    if (!m_model || !m_backwardDone || m_aackNext < m_released || m_iteration + 1 >= m_iterations) {
+        return;
+    }
+    m_iteration++;
+    StartIteration();
+}
+
 void
 CustomClient::Send()
 {
@@ -313,10 +678,83 @@ CustomClient::Send()
 
     NS_ASSERT(m_sendEvent.IsExpired());
 
-    // Format : jobId,partId,gradientId
+    Time wait = GetPacingDelay();
+    if (wait.IsStrictlyPositive())
+    {
+        m_sendEvent = Simulator::Schedule(wait, &CustomClient::Send, this);
+        return;
+    }
+
+    SendGradient(m_sent);
+    ++m_sent;
+
+    if (CanSend())
+    {
+        ScheduleTransmit(GetSendGap());
+    }
+}
+
+void
+CustomClient::SendGradient(uint32_t seq)
+{
+    NS_LOG_FUNCTION(this << seq);
+
+    // Format : jobId,partId,gradientId[,scale[,pairs]] followed by the encoded values
     std::stringstream ss;
-    ss << m_jobId << ',' << m_partId << ',' << m_sent;
-    SetFill(ss.str()); // Set payload to m_sent because counting packets as test
+    ss << m_jobId << ',' << m_partId << ',' << seq;
+    if (m_elements == 0 && (m_gradientTrace || m_model)) {
+        // Replayed gradients keep the packet size, the header is padded with zeros
+        std::string header = ss.str();
+        std::vector<uint8_t> fill(std::max<size_t>(m_tracePacketSize, header.size() + 1), 0);
+        memcpy(fill.data(), header.c_str(), header.size() + 1);
+        SetFill(fill.data(), fill.size(), fill.size());
+    }
+    else if (m_elements == 0) {
+        SetFill(ss.str()); // Set payload to m_sent because counting packets as test
+    }
+    else {
+        std::vector<double> values(m_elements);
+        double maxAbs = 0;
+        for (uint32_t i = 0; i < m_elements; i++) {
+            values[i] = GradientValue(seq, i);
+            maxAbs = std::max(maxAbs, std::abs(values[i]));
+        }
+        // Per packet scale, a power of two so switch and PS can align scales of different workers exactly
+        double scale = 1.0;
+        if (m_dataType == INT32 && maxAbs > 0) {
+            double range = std::numeric_limits<int32_t>::max() / (static_cast<double>(m_fixedPointHeadroom) * maxAbs);
+            scale = std::exp2(std::floor(std::log2(range)));
+        }
+        ss << ',' << std::setprecision(17) << scale;
+        std::vector<uint8_t> payload;
+        if (m_topK == 0 || m_topK >= m_elements) {
+            payload.resize(m_elements * m_aggregator->GetElementSize());
+            m_aggregator->Encode(values.data(), m_elements, scale, payload.data());
+        }
+        else {
+            // Top-k sparsification, pairs are sent in index order
+            std::vector<uint32_t> index(m_elements);
+            for (uint32_t i = 0; i < m_elements; i++) {
+                index[i] = i;
+            }
+            std::nth_element(index.begin(), index.begin() + m_topK, index.end(),
+                             [&values](uint32_t a, uint32_t b) { return std::abs(values[a]) > std::abs(values[b]); });
+            index.resize(m_topK);
+            std::sort(index.begin(), index.end());
+            std::vector<double> topValues(m_topK);
+            for (uint32_t i = 0; i < m_topK; i++) {
+                topValues[i] = values[index[i]];
+            }
+            ss << ',' << m_topK;
+            payload.resize(m_topK * (sizeof(uint32_t) + m_aggregator->GetElementSize()));
+            m_aggregator->EncodeSparse(index.data(), topValues.data(), m_topK, scale, payload.data());
+        }
+        std::string header = ss.str();
+        std::vector<uint8_t> fill(header.size() + 1 + payload.size());
+        memcpy(fill.data(), header.c_str(), header.size() + 1);
+        memcpy(fill.data() + header.size() + 1, payload.data(), payload.size());
+        SetFill(fill.data(), fill.size(), fill.size());
+    }
     Ptr<Packet> p;
     if (m_dataSize)
     {
@@ -343,6 +781,17 @@ CustomClient::Send()
         //
         p = Create<Packet>(m_size);
     }
+    // Retransmits keep the stamps of the first send
+    auto latency = m_latency.find(seq);
+    bool first = latency == m_latency.end();
+    if (first)
+    {
+        LatencyTag stamps;
+        stamps.SetSeq(seq);
+        stamps.SetSend(Simulator::Now());
+        latency = m_latency.insert(std::make_pair(seq, stamps)).first;
+    }
+    p->AddPacketTag(latency->second);
     Address localAddress;
     m_socket->GetSockName(localAddress);
     // call to the trace sinks before the packet is actually sent,
@@ -355,8 +804,42 @@ CustomClient::Send()
             localAddress,
             InetSocketAddress(Ipv4Address::ConvertFrom(m_peerAddr), m_peerPort));
     }
+    if (!m_progressTos.empty())
+    {
+        m_socket->SetIpTos(GetProgressTos());
+    }
+    if (m_pacingRate.GetBitRate() > 0)
+    {
+        // Retransmits go out at once but still draw on the bucket, delaying the next new gradient
+        RefillTokens();
+        m_tokens -= m_size;
+    }
     m_socket->Send(p);
-    ++m_sent;
+    if (seq < m_aackNext || m_aackAbove.count(seq))
+    {
+        // Late part of a gradient that completed with a quorum, nothing is waited for
+        m_latency.erase(seq);
+    }
+    else
+    {
+        m_unacked.insert(seq);
+    }
+    if (m_stats)
+    {
+        m_stats->RecordSend(m_jobId, m_size);
+    }
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(first ? EVENT_WORKER_SEND : EVENT_WORKER_RETRANSMIT, GetNode()->GetId(), m_jobId, seq, m_size);
+    }
+    if (!m_rto.IsZero() && m_rtoEvent.IsExpired())
+    {
+        m_rtoEvent = Simulator::Schedule(m_rto, &CustomClient::Retransmit, this);
+    }
+    if (!m_aackTimeout.IsZero() && m_aackEvent.IsExpired())
+    {
+        m_aackEvent = Simulator::Schedule(m_aackTimeout, &CustomClient::AackRetransmit, this);
+    }
 
     if (Ipv4Address::IsMatchingType(m_peerAddr))
     {
@@ -371,11 +854,167 @@ CustomClient::Send()
             << InetSocketAddress::ConvertFrom(m_peerAddr).GetIpv4() << " port "
             << InetSocketAddress::ConvertFrom(m_peerAddr).GetPort() << " )");
     }
+}
+
+void
+CustomClient::SetPacingRate(DataRate rate)
+{
+    NS_LOG_FUNCTION(this << rate);
+    RefillTokens();
+    m_pacingRate = rate;
+}
+
+DataRate
+CustomClient::GetPacingRate() const
+{
+    return m_pacingRate;
+}
+
+void
+CustomClient::RefillTokens()
+{
+    Time now = Simulator::Now();
+    double burst = std::max(m_pacingBurst, m_size);
+    m_tokens = std::min(burst, m_tokens + m_pacingRate.GetBitRate() / 8.0 * (now - m_tokensUpdated).GetSeconds());
+    m_tokensUpdated = now;
+}
+
+Time
+CustomClient::GetPacingDelay()
+{
+    if (m_pacingRate.GetBitRate() == 0)
+    {
+        return Seconds(0);
+    }
+    RefillTokens();
+    if (m_tokens >= m_size)
+    {
+        return Seconds(0);
+    }
+    return m_pacingRate.CalculateBytesTxTime(std::ceil(m_size - m_tokens));
+}
+
+Time
+CustomClient::GetSendGap() const
+{
+    // The pacer spaces the gradients itself in Send
+    if (m_gradientTrace || m_model || m_pacingRate.GetBitRate() > 0)
+    {
+        return Seconds(0);
+    }
+    return m_interval;
+}
 
-    // if (m_sent < m_count)
-    // {
-    //     ScheduleTransmit(m_interval);
-    // }
+uint8_t
+CustomClient::GetProgressTos() const
+{
+    // A worker that joined late only counts the gradients from its join
+    // A trace is only read as it is replayed, so its workload is what it released so far
+    uint32_t end = m_gradientTrace ? std::min(m_released, m_count) : m_count;
+    double progress = end > m_startSeq ? static_cast<double>(m_aackNext - m_startSeq) / (end - m_startSeq) : 1;
+    size_t level = std::min<size_t>(progress * m_progressTos.size(), m_progressTos.size() - 1);
+    return m_progressTos[level];
+}
+
+double
+CustomClient::GradientValue(uint32_t seq, uint32_t index) const
+{
+    // splitmix64 of the element coordinates, so retransmits carry the same values
+    uint64_t x = (static_cast<uint64_t>(m_jobId) << 48) ^ (static_cast<uint64_t>(m_partId) << 32) ^
+                 (static_cast<uint64_t>(seq) * 0x9e3779b97f4a7c15ULL) ^ index;
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<double>(x >> 11) / static_cast<double>(1ULL << 53) * 2.0 - 1.0;
+}
+
+void
+CustomClient::ReportLatency(uint32_t seq, LatencyTag path, bool tagged)
+{
+    NS_LOG_FUNCTION(this << seq << tagged);
+    auto it = m_latency.find(seq);
+    if (it == m_latency.end())
+    {
+        return;
+    }
+    LatencyTag& stamps = it->second;
+    if (tagged)
+    {
+        stamps.SetSlotComplete(path.GetSlotComplete());
+        stamps.SetPsArrival(path.GetPsArrival());
+    }
+
+    // Unknown stamps collapse onto the previous one so the stages sum to the total
+    Time send = stamps.GetSend();
+    Time switchArrival = stamps.GetSwitchArrival().IsZero() ? send : stamps.GetSwitchArrival();
+    Time slotComplete = stamps.GetSlotComplete().IsZero() ? switchArrival : stamps.GetSlotComplete();
+    Time psArrival = stamps.GetPsArrival().IsZero() ? slotComplete : stamps.GetPsArrival();
+    Time now = Simulator::Now();
+    m_latencyTrace(seq, switchArrival - send, slotComplete - switchArrival, psArrival - slotComplete, now - psArrival);
+    NS_LOG_INFO(now.As(Time::S) << " worker ( " << m_jobId << ',' << m_partId << " ) gradient " << seq
+                << " uplink " << (switchArrival - send).As(Time::US)
+                << " dwell " << (slotComplete - switchArrival).As(Time::US)
+                << " toPs " << (psArrival - slotComplete).As(Time::US)
+                << " ackReturn " << (now - psArrival).As(Time::US));
+    if (m_stats)
+    {
+        m_stats->RecordAggregation(m_jobId, now - send, m_size);
+    }
+    m_latency.erase(it);
+}
+
+void
+CustomClient::Retransmit()
+{
+    NS_LOG_FUNCTION(this);
+
+    std::set<uint32_t> unacked = m_unacked;
+    for (uint32_t seq : unacked)
+    {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId
+                    << " ) retransmit " << seq);
+        SendGradient(seq);
+        ++m_retransmits;
+        if (m_stats)
+        {
+            m_stats->RecordRetransmit(m_jobId);
+        }
+    }
+}
+
+void
+CustomClient::AackRetransmit()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (uint32_t seq = m_aackNext; seq < m_sent; seq++)
+    {
+        // Gradients without GACK are left to the RTO
+        if (m_aackAbove.count(seq) || m_unacked.count(seq))
+        {
+            continue;
+        }
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " worker ( " << m_jobId << ',' << m_partId
+                    << " ) AACK overdue, retransmit " << seq);
+        SendGradient(seq);
+        ++m_retransmits;
+        if (m_stats)
+        {
+            m_stats->RecordRetransmit(m_jobId);
+        }
+    }
+    RestartAackTimer();
+}
+
+void
+CustomClient::RestartAackTimer()
+{
+    Simulator::Cancel(m_aackEvent);
+    if (!m_aackTimeout.IsZero() && m_aackNext < m_sent)
+    {
+        m_aackEvent = Simulator::Schedule(m_aackTimeout, &CustomClient::AackRetransmit, this);
+    }
 }
 
 void
@@ -387,9 +1026,9 @@ CustomClient::HandleRead(Ptr<Socket> socket)
     Address localAddress;
     while ((packet = socket->RecvFrom(from)))
     {
-        uint8_t read_buffer[1000];
-        packet->CopyData(read_buffer, packet->GetSize()); // Copy data from packet
-        std::string read_data(read_buffer, read_buffer+packet->GetSize()); // Read data
+        std::vector<uint8_t> read_buffer(packet->GetSize() + 1, 0);
+        packet->CopyData(read_buffer.data(), packet->GetSize()); // Copy data from packet
+        std::string read_data(reinterpret_cast<char*>(read_buffer.data())); // Read header
         // if (InetSocketAddress::IsMatchingType(from))
         // {
         //     NS_LOG_INFO(Simulator::Now().As(Time::S) << " client received "
@@ -403,13 +1042,109 @@ CustomClient::HandleRead(Ptr<Socket> socket)
         m_rxTrace(packet);
         m_rxTraceWithAddresses(packet, from, localAddress);
         std::vector<std::string> pktAck = split_string(read_data, (char *)",");
-        if (pktAck[0] == "GACK") {
-            m_lastGACK = stoi(pktAck[1]);
-            m_sent = m_lastGACK + 1;
-            uint32_t boundary = std::min(m_lastGACK + m_CWD, m_lastAACK + m_AWD);
-            if (m_sent < m_count && m_sent <= boundary) {   // m_sent = next to send, so within boundary is ok
-                ScheduleTransmit(m_interval);
+        if (m_leaving) {
+            // Stopped, only the answer to the LEAVE is still waited for
+            // Format : LEAVE,jobId,partId
+            if (pktAck[0] == "LEAVE" && stoi(pktAck[1]) == m_jobId && stoi(pktAck[2]) == m_partId) {
+                m_leaving = false;
+                Simulator::Cancel(m_joinEvent);
+                CloseSocket();
+                return;
+            }
+            continue;
+        }
+        if (pktAck[0] == "JOIN") {
+            // Format : JOIN,jobId,partId,fromSeq
+            if (m_elastic && !m_joined && stoi(pktAck[1]) == m_jobId && stoi(pktAck[2]) == m_partId) {
+                m_joined = true;
+                Simulator::Cancel(m_joinEvent);
+                StartSending(stoul(pktAck[3]));
+            }
+        }
+        else if (pktAck[0] == "GACK") {
+            // Format : GACK,highestContiguousSeq,sackBitmap
+            int64_t contiguous = stoll(pktAck[1]);
+            if (m_eventTrace) {
+                m_eventTrace->Record(EVENT_WORKER_GACK, GetNode()->GetId(), m_jobId, contiguous, packet->GetSize());
+            }
+            if (contiguous >= 0) {
+                m_lastGACK = std::max<uint32_t>(m_lastGACK, contiguous);
+                m_unacked.erase(m_unacked.begin(), m_unacked.upper_bound(contiguous));
+            }
+            if (pktAck.size() > 2) {
+                for (uint16_t offset : decode_bitmap(pktAck[2])) {
+                    m_unacked.erase(contiguous + 2 + offset);
+                }
+            }
+
+            LatencyTag path;
+            if (packet->PeekPacketTag(path) && m_latency.count(path.GetSeq())) {
+                m_latency[path.GetSeq()].SetSwitchArrival(path.GetSwitchArrival());
+            }
+
+            // Restart the retransmission timer on progress
+            Simulator::Cancel(m_rtoEvent);
+            if (!m_rto.IsZero() && !m_unacked.empty()) {
+                m_rtoEvent = Simulator::Schedule(m_rto, &CustomClient::Retransmit, this);
+            }
+
+            if (m_sendEvent.IsExpired() && CanSend()) {
+                ScheduleTransmit(GetSendGap());
+            }
+        }
+        else if (pktAck[0] == "AACK" || pktAck[0] == "RESULT") {
+            // Format : AACK,jobId,range[,range...] with each range either seq or first-last
+            // SwitchML results come from the switch : RESULT,jobId,seq,bitmap[,scale] followed by the values
+            if (stoi(pktAck[1]) != m_jobId) {
+                continue;
+            }
+            std::set<uint32_t> acked;
+            if (pktAck[0] == "RESULT") {
+                acked.insert(stoul(pktAck[2]));
+            }
+            else {
+                for (size_t i = 2; i < pktAck.size(); i++) {
+                    decode_range(pktAck[i], acked);
+                }
+            }
+            LatencyTag path;
+            bool tagged = packet->PeekPacketTag(path);
+            for (uint32_t seq : acked) {
+                if (seq >= m_aackNext && !m_aackAbove.count(seq)) {
+                    ReportLatency(seq, path, tagged && path.GetSeq() == seq);
+                    if (m_eventTrace) {
+                        m_eventTrace->Record(EVENT_WORKER_AACK, GetNode()->GetId(), m_jobId, seq, packet->GetSize());
+                    }
+                }
+            }
+            // The AACK also proves the gradients arrived, the only receipt PS, ATP and SwitchML get
+            bool progress = false;
+            for (uint32_t seq : acked) {
+                progress |= m_unacked.erase(seq) > 0;
+            }
+            if (progress && m_protocol != PROTOCOL_PA_ATP) {
+                Simulator::Cancel(m_rtoEvent);
+                if (!m_rto.IsZero() && !m_unacked.empty()) {
+                    m_rtoEvent = Simulator::Schedule(m_rto, &CustomClient::Retransmit, this);
+                }
+            }
+            m_aackAbove.insert(acked.begin(), acked.end());
+            m_aackAbove.erase(m_aackAbove.begin(), m_aackAbove.lower_bound(m_aackNext));
+            uint32_t aackNext = m_aackNext;
+            while (!m_aackAbove.empty() && *m_aackAbove.begin() == m_aackNext) {
+                m_aackAbove.erase(m_aackAbove.begin());
+                m_aackNext++;
+            }
+            if (m_aackNext > aackNext) {
+                RestartAackTimer();
+            }
+            if (m_aackNext > 0) {
+                m_lastAACK = m_aackNext - 1;
+            }
+            CheckIteration();
 
+            if (m_sendEvent.IsExpired() && CanSend()) {
+                ScheduleTransmit(GetSendGap());
             }
         }
 
@@ -2,10 +2,22 @@
 #define CUSTOM_CLIENT_H
 
 #include "ns3/application.h"
+#include "ns3/data-rate.h"
 #include "ns3/event-id.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
+#include "ns3/aggregator.h"
+#include "ns3/latency_tag.h"
+#include "ns3/job_stats.h"
+#include "ns3/event_trace.h"
+#include "ns3/gradient_trace.h"
+#include "ns3/model_profile.h"
+#include "ns3/protocol_mode.h"
+
+#include <map>
+#include <set>
 
 namespace ns3
 {
@@ -112,7 +124,35 @@ class CustomClient : public Application
      * \param dataSize The desired size of the final echo data.
      */
     void SetFill(uint8_t* fill, uint32_t fillSize, uint32_t dataSize);
-    
+
+    /**
+     * \brief Set the rate the token bucket pacer refills at.
+     *
+     * StartApplication derives the rate from PacingFraction, a congestion
+     * controller can change it at any time after. None of the protocols
+     * drives it yet. Tokens earned at the old rate are kept.
+     *
+     * \param rate the pacing rate (zero disables pacing)
+     */
+    void SetPacingRate(DataRate rate);
+    /**
+     * \return the current pacing rate, zero if pacing is disabled
+     */
+    DataRate GetPacingRate() const;
+
+    /**
+     * TracedCallback signature for the latency breakdown of an AACKed gradient.
+     *
+     * Stamps missing from the returned tags collapse onto the previous stage,
+     * so the stages always add up to the gradient completion time.
+     *
+     * \param [in] seq gradient seq
+     * \param [in] uplink worker queue and links up to the switch
+     * \param [in] dwell wait in the switch slot for the other parts
+     * \param [in] toPs switch to PS
+     * \param [in] ackReturn PS aggregation and AACK return to the worker
+     */
+    typedef void (*LatencyTracedCallback)(uint32_t seq, Time uplink, Time dwell, Time toPs, Time ackReturn);
 
   private:
     void StartApplication() override;
@@ -124,9 +164,129 @@ class CustomClient : public Application
      */
     void ScheduleTransmit(Time dt);
     /**
-     * \brief Send a packet
+     * \brief Send the next new gradient and keep filling the window
+     *
+     * The gradient waits for the pacer when the token bucket holds less than
+     * one packet.
      */
     void Send();
+    /**
+     * \brief Add the tokens earned since the last refill, up to the bucket size
+     */
+    void RefillTokens();
+    /**
+     * \brief Get the time until the token bucket holds one packet.
+     * \return the wait, zero if a packet can be sent now or pacing is disabled
+     */
+    Time GetPacingDelay();
+    /**
+     * \brief Get the gap between two new gradients.
+     *
+     * Gradients released by a trace or a model profile go back to back,
+     * only the window holds them. With pacing the token bucket spaces the
+     * gradients, otherwise they are spaced by Interval.
+     *
+     * \return the gap
+     */
+    Time GetSendGap() const;
+    /**
+     * \brief Send a gradient packet
+     * \param seq gradient seq to send
+     */
+    void SendGradient(uint32_t seq);
+    /**
+     * \brief Start sending gradients from a seq on
+     *
+     * Everything below fromSeq counts as AACKed, the trace or model profile
+     * starts now.
+     *
+     * \param fromSeq first seq the worker sends
+     */
+    void StartSending(uint32_t fromSeq);
+    /**
+     * \brief Ask the switch to add the worker to its job, again every JoinTimeout until answered
+     */
+    void SendJoin();
+    /**
+     * \brief Ask the switch to remove the worker from its job, again every JoinTimeout until answered
+     */
+    void SendLeave();
+    /**
+     * \brief Close the socket and stop receiving
+     */
+    void CloseSocket();
+    /**
+     * \brief Check whether the next new gradient fits in the send window
+     * \return true if it can be sent now
+     */
+    bool CanSend() const;
+    /**
+     * \brief Schedule the release of the next gradient trace record of this worker
+     */
+    void ScheduleRelease();
+    /**
+     * \brief Release the gradients of the current trace record for sending
+     */
+    void Release();
+    /**
+     * \brief Release gradients for sending
+     * \param bytes gradient bytes, split into PacketSize packets
+     */
+    void ReleaseBytes(uint64_t bytes);
+    /**
+     * \brief Start the forward pass of the next model iteration
+     */
+    void StartIteration();
+    /**
+     * \brief Finish the backward compute of a layer and release its gradient
+     * \param layer layer index in the model profile
+     */
+    void Backward(uint32_t layer);
+    /**
+     * \brief Start the next iteration once every gradient of this one is AACKed
+     */
+    void CheckIteration();
+    /**
+     * \brief Get the value of one gradient element, uniform in [-1, 1).
+     * \param seq gradient seq
+     * \param index element index in the packet
+     * \return the value
+     */
+    double GradientValue(uint32_t seq, uint32_t index) const;
+    /**
+     * \brief Get the TOS of the next packet from the progress of the worker.
+     *
+     * Progress is the AACKed share of the gradients the worker sends from its
+     * join to the end of its workload (MaxPackets, the model iterations or
+     * what the trace released so far), cut into one class per ProgressTos
+     * entry. The first entry is for the workers that lag most, so a priority
+     * queue can serve them first.
+     *
+     * \return the TOS byte
+     */
+    uint8_t GetProgressTos() const;
+    /**
+     * \brief Retransmit every gradient that is not acknowledged by a GACK yet
+     */
+    void Retransmit();
+    /**
+     * \brief Retransmit every GACKed gradient whose AACK is overdue.
+     *
+     * The switch has the gradient, so its result or the AACK was lost. A
+     * switch with a result cache answers from it.
+     */
+    void AackRetransmit();
+    /**
+     * \brief Restart the AACK timer while gradients wait for their AACK
+     */
+    void RestartAackTimer();
+    /**
+     * \brief Report the latency breakdown of an AACKed gradient.
+     * \param seq gradient seq
+     * \param path tag returned with the AACK
+     * \param tagged whether the AACK carried path stamps for this seq
+     */
+    void ReportLatency(uint32_t seq, LatencyTag path, bool tagged);
 
     /**
      * \brief Handle a packet reception.
@@ -149,19 +309,67 @@ class CustomClient : public Application
     Address m_peerAddr; //!< Remote peer address
     uint16_t m_peerPort;   //!< Remote peer port
     uint8_t m_tos;         //!< The packets Type of Service
+    std::string m_progressTosList;       //!< TOS per progress class, comma separated (empty disables it)
+    std::vector<uint8_t> m_progressTos;  //!< Parsed m_progressTosList, lagging class first
     EventId m_sendEvent;   //!< Event to send the next packet
+    double m_pacingFraction;  //!< Share of the link rate the pacer sends at (zero disables it)
+    uint32_t m_pacingBurst;   //!< Token bucket size in bytes, at least one packet
+    DataRate m_pacingRate;    //!< Token refill rate (zero disables pacing)
+    double m_tokens;          //!< Bytes the pacer can send now, negative after retransmits
+    Time m_tokensUpdated;     //!< Time of the last refill
 
     //////////// CUSTOM ////////////
     uint16_t m_port;
-    uint32_t m_lastAACK; // Aggregation AACK
-    uint32_t m_lastGACK; // Gradient AACK
+    TracedValue<uint32_t> m_lastAACK; // Aggregation AACK
+    TracedValue<uint32_t> m_lastGACK; // Gradient AACK
     uint16_t m_jobId;
     uint16_t m_partId;
-    uint32_t m_AWD;
-    uint32_t m_CWD;
+    bool m_elastic;               //!< Whether the worker joins and leaves its job through the switch
+    bool m_joined;                //!< Whether the switch answered the JOIN
+    bool m_leaving;               //!< Whether the worker stopped and waits for the LEAVE answer
+    Time m_joinTimeout;           //!< Time before an unanswered JOIN or LEAVE is resent
+    EventId m_joinEvent;          //!< JOIN or LEAVE retransmission
+    TracedValue<uint32_t> m_AWD;
+    TracedValue<uint32_t> m_CWD;
+    uint32_t m_initialAwd;        //!< Aggregation window the worker starts with
+    uint32_t m_initialCwd;        //!< Congestion window the worker starts with
     Address m_multicast;
+    ProtocolMode m_protocol;      //!< Aggregation protocol, PS and ATP ignore the GACK window
+    uint32_t m_slotPool;          //!< Switch slots of the job in SwitchML mode
+    Time m_rto;                   //!< Retransmission timeout (zero disables retransmission)
+    EventId m_rtoEvent;           //!< Retransmission timer
+    std::set<uint32_t> m_unacked; //!< Sent gradients not covered by a GACK yet
+    Time m_aackTimeout;           //!< Time without AACK progress before GACKed gradients are resent (zero disables it)
+    EventId m_aackEvent;          //!< AACK timer
+    uint32_t m_retransmits;       //!< Counter for retransmitted packets
+    uint32_t m_aackNext;          //!< Lowest seq not covered by an AACK yet
+    uint32_t m_startSeq;          //!< First seq of the worker, its join seq when elastic
+    std::set<uint32_t> m_aackAbove; //!< AACKed seqs beyond the first gap
+    uint32_t m_elements;          //!< Gradient values carried per packet
+    AggregationDataType m_dataType; //!< Element type of the gradient values
+    uint32_t m_fixedPointHeadroom; //!< Contributions an INT32 sum holds without saturating
+    uint32_t m_topK;              //!< Largest magnitude values sent per packet (zero sends dense values)
+    Ptr<Aggregator> m_aggregator; //!< Encoder of the gradient values
+    std::map<uint32_t, LatencyTag> m_latency; //!< Path stamps of gradients not AACKed yet
+    Ptr<JobStats> m_stats;        //!< Metrics collector (may be null)
+    Ptr<EventTrace> m_eventTrace; //!< Binary event log (may be null)
+    Ptr<GradientTrace> m_gradientTrace; //!< Replayed emission trace (null sends every Interval)
+    uint64_t m_traceCursor;       //!< Index of the next trace record of this worker
+    Time m_traceStart;            //!< Simulation time of trace time zero
+    uint32_t m_released;          //!< Gradients released by the trace so far
+    uint32_t m_tracePacketSize;   //!< Packet size the trace bytes are split into
+    EventId m_releaseEvent;       //!< Release of the next trace record or layer gradient
+    std::string m_modelName;      //!< Model profile the worker trains (empty disables it)
+    const ModelProfile* m_model;  //!< Profile of m_modelName
+    uint32_t m_iterations;        //!< Training iterations to run
+    uint32_t m_iteration;         //!< Current iteration
+    double m_computeScale;        //!< Factor applied to the profile compute times
+    bool m_backwardDone;          //!< Whether every layer of the iteration is released
     ////////////////////////////////
 
+    /// Callbacks for tracing the latency breakdown of AACKed gradients
+    TracedCallback<uint32_t, Time, Time, Time, Time> m_latencyTrace;
+
     /// Callbacks for tracing the packet Tx events
     TracedCallback<Ptr<const Packet>> m_txTrace;
 
@@ -0,0 +1,115 @@
+#include "event_trace.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("EventTrace");
+
+NS_OBJECT_ENSURE_REGISTERED(EventTrace);
+
+const char*
+GetEventTypeName(uint8_t type)
+{
+    static const char* names[EVENT_TYPE_COUNT] = {
+        "WORKER_SEND",
+        "WORKER_RETRANSMIT",
+        "WORKER_GACK",
+        "WORKER_AACK",
+        "SWITCH_RX",
+        "SWITCH_GACK",
+        "SWITCH_RESULT",
+        "SWITCH_PARTIAL",
+        "SWITCH_FALLBACK",
+        "PS_RX",
+        "PS_AACK",
+        "PS_UPDATE",
+        "SWITCH_MEMBERSHIP",
+    };
+    return type < EVENT_TYPE_COUNT ? names[type] : "UNKNOWN";
+}
+
+TypeId
+EventTrace::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::EventTrace")
+            .SetParent<Object>()
+            .SetGroupName("Applications")
+            .AddConstructor<EventTrace>()
+            .AddAttribute("FileName",
+                          "File the event records are written to",
+                          StringValue("events.bin"),
+                          MakeStringAccessor(&EventTrace::m_fileName),
+                          MakeStringChecker())
+            .AddAttribute("BufferRecords",
+                          "Number of records buffered before they are written",
+                          UintegerValue(4096),
+                          MakeUintegerAccessor(&EventTrace::m_bufferRecords),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+EventTrace::EventTrace()
+{
+    NS_LOG_FUNCTION(this);
+    // The event holds a reference, so the tail is written after the applications are gone
+    Simulator::ScheduleDestroy(&EventTrace::Flush, Ptr<EventTrace>(this));
+}
+
+EventTrace::~EventTrace()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+EventTrace::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Flush();
+    Object::DoDispose();
+}
+
+void
+EventTrace::Record(EventType type, uint32_t node, uint16_t jobId, uint32_t seq, uint32_t size)
+{
+    EventRecord record;
+    record.time = Simulator::Now().GetNanoSeconds();
+    record.node = node;
+    record.seq = seq;
+    record.size = size;
+    record.jobId = jobId;
+    record.type = type;
+    record.pad = 0;
+    m_buffer.push_back(record);
+    if (m_buffer.size() >= m_bufferRecords)
+    {
+        Flush();
+    }
+}
+
+void
+EventTrace::Flush()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_file.is_open())
+    {
+        m_file.open(m_fileName, std::ios::out | std::ios::binary);
+        NS_ABORT_MSG_IF(!m_file, "Cannot open " << m_fileName);
+        uint32_t version = VERSION;
+        uint32_t recordSize = sizeof(EventRecord);
+        m_file.write("PAEV", 4);
+        m_file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        m_file.write(reinterpret_cast<const char*>(&recordSize), sizeof(recordSize));
+    }
+    m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size() * sizeof(EventRecord));
+    m_file.flush();
+    m_buffer.clear();
+}
+
+} // namespace ns3
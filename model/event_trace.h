@@ -0,0 +1,110 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include "ns3/object.h"
+
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Protocol events recorded by EventTrace.
+ */
+enum EventType : uint8_t
+{
+    EVENT_WORKER_SEND,       //!< Worker sent a new gradient
+    EVENT_WORKER_RETRANSMIT, //!< Worker retransmitted a gradient
+    EVENT_WORKER_GACK,       //!< Worker received a GACK, seq is the cumulative point
+    EVENT_WORKER_AACK,       //!< Worker received the AACK of a gradient
+    EVENT_SWITCH_RX,         //!< Switch received a gradient
+    EVENT_SWITCH_GACK,       //!< Switch sent a GACK, seq is the cumulative point
+    EVENT_SWITCH_RESULT,     //!< Switch sent a complete slot to the PS
+    EVENT_SWITCH_PARTIAL,    //!< Switch flushed an incomplete slot to the PS
+    EVENT_SWITCH_FALLBACK,   //!< Switch forwarded a gradient to the PS
+    EVENT_PS_RX,             //!< PS merged a contribution
+    EVENT_PS_AACK,           //!< PS sent an AACK, seq is the highest acknowledged
+    EVENT_PS_UPDATE,         //!< PS applied the update of a gradient
+    EVENT_SWITCH_MEMBERSHIP, //!< Switch added or removed a worker, seq is its first seq or the frontier, size the fan-in
+    EVENT_TYPE_COUNT,
+};
+
+/**
+ * \brief Get the name of an event type.
+ * \param type event type
+ * \return the name, "UNKNOWN" for out of range values
+ */
+const char* GetEventTypeName(uint8_t type);
+
+/**
+ * \brief One fixed size record of the binary event trace.
+ */
+struct EventRecord
+{
+    int64_t time;    //!< Simulation time in ns
+    uint32_t node;   //!< Node id of the recording application
+    uint32_t seq;    //!< Gradient seq
+    uint32_t size;   //!< Packet size in bytes
+    uint16_t jobId;  //!< Job id
+    uint8_t type;    //!< EventType
+    uint8_t pad;     //!< Keeps the record 8 byte aligned
+};
+
+static_assert(sizeof(EventRecord) == 24, "EventRecord must stay 24 bytes");
+
+/**
+ * \ingroup applications
+ * \brief Buffered writer of fixed size binary event records.
+ *
+ * A much cheaper replacement of the per packet NS_LOG_INFO lines for large
+ * runs. The file starts with the magic "PAEV", a uint32_t version and the
+ * uint32_t record size, followed by EventRecord structs in host byte order.
+ * Records are buffered and written BufferRecords at a time, the remainder at
+ * Simulator::Destroy.
+ */
+class EventTrace : public Object
+{
+  public:
+    static const uint32_t VERSION = 1; //!< File format version
+
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    EventTrace();
+
+    ~EventTrace() override;
+
+    /**
+     * \brief Record an event at the current simulation time.
+     * \param type event type
+     * \param node node id of the recording application
+     * \param jobId job id
+     * \param seq gradient seq
+     * \param size packet size in bytes
+     */
+    void Record(EventType type, uint32_t node, uint16_t jobId, uint32_t seq, uint32_t size);
+
+    /**
+     * \brief Write the buffered records to the file.
+     */
+    void Flush();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    std::string m_fileName;              //!< Output file
+    uint32_t m_bufferRecords;            //!< Records buffered before a write
+    std::ofstream m_file;                //!< Output stream
+    std::vector<EventRecord> m_buffer;   //!< Records not written yet
+};
+
+} // namespace ns3
+
+#endif /* EVENT_TRACE_H */
@@ -0,0 +1,141 @@
+#include "gradient_trace.h"
+
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/string.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("GradientTrace");
+
+NS_OBJECT_ENSURE_REGISTERED(GradientTrace);
+
+/// Size of the file header : magic, version and record size
+static const size_t GRADIENT_TRACE_HEADER = 12;
+
+TypeId
+GradientTrace::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::GradientTrace")
+            .SetParent<Object>()
+            .SetGroupName("Applications")
+            .AddConstructor<GradientTrace>()
+            .AddAttribute("FileName",
+                          "Gradient emission trace to replay",
+                          StringValue(""),
+                          MakeStringAccessor(&GradientTrace::m_fileName),
+                          MakeStringChecker());
+    return tid;
+}
+
+GradientTrace::GradientTrace()
+    : m_fd(-1),
+      m_map(nullptr),
+      m_mapSize(0),
+      m_records(nullptr),
+      m_count(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+GradientTrace::~GradientTrace()
+{
+    NS_LOG_FUNCTION(this);
+    Unmap();
+}
+
+void
+GradientTrace::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Unmap();
+    Object::DoDispose();
+}
+
+void
+GradientTrace::Map()
+{
+    NS_LOG_FUNCTION(this << m_fileName);
+    m_fd = open(m_fileName.c_str(), O_RDONLY);
+    NS_ABORT_MSG_IF(m_fd < 0, "Cannot open gradient trace " << m_fileName);
+    struct stat st;
+    NS_ABORT_MSG_IF(fstat(m_fd, &st) != 0 || static_cast<size_t>(st.st_size) < GRADIENT_TRACE_HEADER,
+                    "Gradient trace " << m_fileName << " has no header");
+    m_mapSize = st.st_size;
+    m_map = mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    NS_ABORT_MSG_IF(m_map == MAP_FAILED, "Cannot map gradient trace " << m_fileName);
+    // The replay walks the records in order
+    madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(m_map);
+    uint32_t version;
+    uint32_t recordSize;
+    std::memcpy(&version, base + 4, sizeof(version));
+    std::memcpy(&recordSize, base + 8, sizeof(recordSize));
+    NS_ABORT_MSG_IF(std::memcmp(base, "PAGT", 4) != 0 || version != VERSION ||
+                        recordSize != sizeof(GradientTraceRecord),
+                    m_fileName << " is not a version " << VERSION << " gradient trace");
+    m_records = reinterpret_cast<const GradientTraceRecord*>(base + GRADIENT_TRACE_HEADER);
+    m_count = (m_mapSize - GRADIENT_TRACE_HEADER) / sizeof(GradientTraceRecord);
+    NS_LOG_INFO("Mapped " << m_count << " gradient records from " << m_fileName);
+}
+
+void
+GradientTrace::Unmap()
+{
+    if (m_map && m_map != MAP_FAILED)
+    {
+        munmap(m_map, m_mapSize);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_records = nullptr;
+    m_count = 0;
+}
+
+uint64_t
+GradientTrace::GetRecordCount()
+{
+    if (!m_records)
+    {
+        Map();
+    }
+    return m_count;
+}
+
+const GradientTraceRecord&
+GradientTrace::GetRecord(uint64_t index)
+{
+    NS_ASSERT(index < GetRecordCount());
+    return m_records[index];
+}
+
+bool
+GradientTrace::FindNext(uint16_t jobId, uint16_t workerId, uint64_t& cursor)
+{
+    // Records are read in file order, the sequential access the mapping is advised for
+    for (uint64_t count = GetRecordCount(); cursor < count; cursor++)
+    {
+        if (m_records[cursor].jobId == jobId && m_records[cursor].workerId == workerId)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace ns3
@@ -0,0 +1,96 @@
+#ifndef GRADIENT_TRACE_H
+#define GRADIENT_TRACE_H
+
+#include "ns3/object.h"
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \brief One gradient emission of a recorded training job.
+ */
+struct GradientTraceRecord
+{
+    int64_t time;      //!< Emission time in ns from the start of the trace
+    uint64_t bytes;    //!< Size of the tensor gradient
+    uint32_t tensor;   //!< Tensor id within the job
+    uint16_t jobId;    //!< Job id
+    uint16_t workerId; //!< Worker id, matched against the worker PartId
+};
+
+static_assert(sizeof(GradientTraceRecord) == 24, "GradientTraceRecord must stay 24 bytes");
+
+/**
+ * \ingroup applications
+ * \brief Memory mapped gradient emission trace shared by the replaying workers.
+ *
+ * The file starts with the magic "PAGT", a uint32_t version and the
+ * uint32_t record size, followed by GradientTraceRecord structs in host
+ * byte order sorted by time. The file is mapped read only and each worker
+ * scans forward from its own cursor, so the replay keeps no per record
+ * state and traces larger than memory are paged in as they are read.
+ */
+class GradientTrace : public Object
+{
+  public:
+    static const uint32_t VERSION = 1; //!< File format version
+
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    GradientTrace();
+
+    ~GradientTrace() override;
+
+    /**
+     * \return the number of records, mapping the file on first use
+     */
+    uint64_t GetRecordCount();
+
+    /**
+     * \brief Get a record.
+     * \param index record index, below GetRecordCount()
+     * \return the record
+     */
+    const GradientTraceRecord& GetRecord(uint64_t index);
+
+    /**
+     * \brief Find the next record of a worker.
+     * \param jobId job of the worker
+     * \param workerId worker id
+     * \param cursor index to search from, set to the matching record
+     * \return false if the worker has no record left
+     */
+    bool FindNext(uint16_t jobId, uint16_t workerId, uint64_t& cursor);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * \brief Map the file and check its header.
+     */
+    void Map();
+
+    /**
+     * \brief Unmap the file.
+     */
+    void Unmap();
+
+    std::string m_fileName;                //!< Trace file
+    int m_fd;                              //!< File descriptor of the mapping
+    void* m_map;                           //!< Start of the mapping
+    size_t m_mapSize;                      //!< Size of the mapping
+    const GradientTraceRecord* m_records;  //!< First record
+    uint64_t m_count;                      //!< Number of records
+};
+
+} // namespace ns3
+
+#endif /* GRADIENT_TRACE_H */
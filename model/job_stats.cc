@@ -0,0 +1,369 @@
+#include "job_stats.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("JobStats");
+
+NS_OBJECT_ENSURE_REGISTERED(JobStats);
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts(BUCKETS, 0),
+      m_total(0),
+      m_min(std::numeric_limits<uint64_t>::max()),
+      m_max(0),
+      m_sum(0)
+{
+}
+
+uint32_t
+LatencyHistogram::GetIndex(uint64_t value)
+{
+    // Values below 2 * SUB_COUNT have a bucket each
+    if (value < 2 * SUB_COUNT)
+    {
+        return value;
+    }
+    uint32_t msb = 63;
+    while (!(value >> msb))
+    {
+        msb--;
+    }
+    uint32_t shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + ((value >> shift) - SUB_COUNT);
+}
+
+uint64_t
+LatencyHistogram::GetLowest(uint32_t index)
+{
+    if (index < 2 * SUB_COUNT)
+    {
+        return index;
+    }
+    uint32_t shift = index / SUB_COUNT - 1;
+    return static_cast<uint64_t>(index % SUB_COUNT + SUB_COUNT) << shift;
+}
+
+uint64_t
+LatencyHistogram::GetHighest(uint32_t index)
+{
+    if (index < 2 * SUB_COUNT)
+    {
+        return index;
+    }
+    uint32_t shift = index / SUB_COUNT - 1;
+    return GetLowest(index) + ((static_cast<uint64_t>(1) << shift) - 1);
+}
+
+void
+LatencyHistogram::Record(uint64_t value)
+{
+    m_counts[GetIndex(value)]++;
+    m_total++;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+    m_sum += value;
+}
+
+uint64_t
+LatencyHistogram::GetCount() const
+{
+    return m_total;
+}
+
+uint64_t
+LatencyHistogram::GetMin() const
+{
+    return m_total ? m_min : 0;
+}
+
+uint64_t
+LatencyHistogram::GetMax() const
+{
+    return m_max;
+}
+
+double
+LatencyHistogram::GetMean() const
+{
+    return m_total ? m_sum / m_total : 0;
+}
+
+uint64_t
+LatencyHistogram::GetPercentile(double percentile) const
+{
+    if (m_total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100 * m_total));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+        {
+            uint64_t mid = GetLowest(i) + (GetHighest(i) - GetLowest(i)) / 2;
+            return std::min(std::max(mid, m_min), m_max);
+        }
+    }
+    return m_max;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>>
+LatencyHistogram::GetBuckets() const
+{
+    std::vector<std::pair<uint64_t, uint64_t>> buckets;
+    for (uint32_t i = 0; i < BUCKETS; i++)
+    {
+        if (m_counts[i])
+        {
+            buckets.emplace_back(GetLowest(i), m_counts[i]);
+        }
+    }
+    return buckets;
+}
+
+TypeId
+JobStats::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::JobStats")
+            .SetParent<Object>()
+            .SetGroupName("Applications")
+            .AddConstructor<JobStats>()
+            .AddAttribute("JsonFile",
+                          "File the JSON report is written to at Simulator::Destroy (empty disables it)",
+                          StringValue(""),
+                          MakeStringAccessor(&JobStats::m_jsonFile),
+                          MakeStringChecker())
+            .AddAttribute("CsvFile",
+                          "File the CSV report is written to at Simulator::Destroy (empty disables it)",
+                          StringValue(""),
+                          MakeStringAccessor(&JobStats::m_csvFile),
+                          MakeStringChecker());
+    return tid;
+}
+
+JobStats::JobStats()
+{
+    NS_LOG_FUNCTION(this);
+    // The event holds a reference, so the report outlives the applications
+    Simulator::ScheduleDestroy(&JobStats::Dump, Ptr<JobStats>(this));
+}
+
+JobStats::~JobStats()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+JobStats::RecordSend(uint16_t jobId, uint32_t bytes)
+{
+    Job& job = m_jobs[jobId];
+    if (!job.started)
+    {
+        job.start = Simulator::Now();
+        job.started = true;
+    }
+    job.sentBytes += bytes;
+}
+
+void
+JobStats::RecordRetransmit(uint16_t jobId)
+{
+    m_jobs[jobId].retransmits++;
+}
+
+void
+JobStats::RecordAggregation(uint16_t jobId, Time latency, uint32_t bytes)
+{
+    Job& job = m_jobs[jobId];
+    job.end = std::max(job.end, Simulator::Now());
+    job.ackedBytes += bytes;
+    job.latency.Record(std::max<int64_t>(latency.GetNanoSeconds(), 0));
+}
+
+void
+JobStats::RecordFallback(uint16_t jobId)
+{
+    m_jobs[jobId].fallbacks++;
+}
+
+void
+JobStats::RecordSwitchMemory(uint16_t jobId, uint32_t bytes)
+{
+    Job& job = m_jobs[jobId];
+    job.memoryPeak = std::max(job.memoryPeak, bytes);
+}
+
+void
+JobStats::RecordSlotLookup(uint16_t jobId, bool collided, bool found)
+{
+    Job& job = m_jobs[jobId];
+    job.slotLookups++;
+    job.collisions += collided ? 1 : 0;
+    job.collisionFallbacks += found ? 0 : 1;
+}
+
+void
+JobStats::RecordPreemption(uint16_t jobId)
+{
+    m_jobs[jobId].preemptions++;
+}
+
+void
+JobStats::RecordLateContribution(uint16_t jobId)
+{
+    m_jobs[jobId].lateContributions++;
+}
+
+void
+JobStats::RecordMembershipChange(uint16_t jobId)
+{
+    m_jobs[jobId].membershipChanges++;
+}
+
+Time
+JobStats::GetJobCompletionTime(uint16_t jobId) const
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end() || it->second.end <= it->second.start)
+    {
+        return Seconds(0);
+    }
+    return it->second.end - it->second.start;
+}
+
+double
+JobStats::GetGoodput(uint16_t jobId) const
+{
+    Time jct = GetJobCompletionTime(jobId);
+    return jct.IsPositive() ? m_jobs.at(jobId).ackedBytes * 8 / jct.GetSeconds() : 0;
+}
+
+double
+JobStats::GetCollisionRate(uint16_t jobId) const
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end() || it->second.slotLookups == 0)
+    {
+        return 0;
+    }
+    return static_cast<double>(it->second.collisions) / it->second.slotLookups;
+}
+
+void
+JobStats::Dump() const
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_jsonFile.empty())
+    {
+        DumpJson(m_jsonFile);
+    }
+    if (!m_csvFile.empty())
+    {
+        DumpCsv(m_csvFile);
+    }
+}
+
+void
+JobStats::DumpJson(std::string fileName) const
+{
+    std::ofstream out(fileName);
+    if (!out)
+    {
+        NS_LOG_ERROR("Cannot open " << fileName);
+        return;
+    }
+    // Times in seconds, latencies in microseconds, goodput in bits per second
+    out << "{\n  \"jobs\": [";
+    bool first = true;
+    for (const auto& entry : m_jobs)
+    {
+        const Job& job = entry.second;
+        Time jct = GetJobCompletionTime(entry.first);
+        double goodput = GetGoodput(entry.first);
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\n"
+            << "      \"jobId\": " << entry.first << ",\n"
+            << "      \"start\": " << job.start.GetSeconds() << ",\n"
+            << "      \"end\": " << job.end.GetSeconds() << ",\n"
+            << "      \"jct\": " << jct.GetSeconds() << ",\n"
+            << "      \"sentBytes\": " << job.sentBytes << ",\n"
+            << "      \"ackedBytes\": " << job.ackedBytes << ",\n"
+            << "      \"goodput\": " << goodput << ",\n"
+            << "      \"retransmits\": " << job.retransmits << ",\n"
+            << "      \"fallbacks\": " << job.fallbacks << ",\n"
+            << "      \"switchMemoryPeak\": " << job.memoryPeak << ",\n"
+            << "      \"slotLookups\": " << job.slotLookups << ",\n"
+            << "      \"collisions\": " << job.collisions << ",\n"
+            << "      \"collisionRate\": " << GetCollisionRate(entry.first) << ",\n"
+            << "      \"collisionFallbacks\": " << job.collisionFallbacks << ",\n"
+            << "      \"preemptions\": " << job.preemptions << ",\n"
+            << "      \"lateContributions\": " << job.lateContributions << ",\n"
+            << "      \"membershipChanges\": " << job.membershipChanges << ",\n"
+            << "      \"latency\": {\n"
+            << "        \"count\": " << job.latency.GetCount() << ",\n"
+            << "        \"min\": " << job.latency.GetMin() / 1e3 << ",\n"
+            << "        \"mean\": " << job.latency.GetMean() / 1e3 << ",\n"
+            << "        \"p50\": " << job.latency.GetPercentile(50) / 1e3 << ",\n"
+            << "        \"p90\": " << job.latency.GetPercentile(90) / 1e3 << ",\n"
+            << "        \"p99\": " << job.latency.GetPercentile(99) / 1e3 << ",\n"
+            << "        \"p999\": " << job.latency.GetPercentile(99.9) / 1e3 << ",\n"
+            << "        \"max\": " << job.latency.GetMax() / 1e3 << ",\n"
+            << "        \"buckets\": [";
+        bool firstBucket = true;
+        for (const auto& bucket : job.latency.GetBuckets())
+        {
+            out << (firstBucket ? "" : ", ") << '[' << bucket.first / 1e3 << ", " << bucket.second << ']';
+            firstBucket = false;
+        }
+        out << "]\n      }\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void
+JobStats::DumpCsv(std::string fileName) const
+{
+    std::ofstream out(fileName);
+    if (!out)
+    {
+        NS_LOG_ERROR("Cannot open " << fileName);
+        return;
+    }
+    out << "jobId,start_s,end_s,jct_s,sent_bytes,acked_bytes,goodput_bps,retransmits,fallbacks,"
+           "switch_memory_peak_bytes,slot_lookups,collisions,collision_rate,collision_fallbacks,"
+           "preemptions,late_contributions,membership_changes,latency_count,latency_min_us,latency_mean_us,latency_p50_us,latency_p90_us,"
+           "latency_p99_us,latency_p999_us,latency_max_us\n";
+    for (const auto& entry : m_jobs)
+    {
+        const Job& job = entry.second;
+        Time jct = GetJobCompletionTime(entry.first);
+        double goodput = GetGoodput(entry.first);
+        out << entry.first << ',' << job.start.GetSeconds() << ',' << job.end.GetSeconds() << ','
+            << jct.GetSeconds() << ',' << job.sentBytes << ',' << job.ackedBytes << ',' << goodput << ','
+            << job.retransmits << ',' << job.fallbacks << ',' << job.memoryPeak << ',' << job.slotLookups << ','
+            << job.collisions << ',' << GetCollisionRate(entry.first) << ',' << job.collisionFallbacks << ','
+            << job.preemptions << ',' << job.lateContributions << ',' << job.membershipChanges << ','
+            << job.latency.GetCount() << ','
+            << job.latency.GetMin() / 1e3 << ',' << job.latency.GetMean() / 1e3 << ','
+            << job.latency.GetPercentile(50) / 1e3 << ',' << job.latency.GetPercentile(90) / 1e3 << ','
+            << job.latency.GetPercentile(99) / 1e3 << ',' << job.latency.GetPercentile(99.9) / 1e3 << ','
+            << job.latency.GetMax() / 1e3 << '\n';
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,204 @@
+#ifndef JOB_STATS_H
+#define JOB_STATS_H
+
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Log bucketed histogram of non negative values in constant memory.
+ *
+ * Like an HDR histogram every power of two range is split into
+ * 2^SUB_BITS linear sub buckets, so any recorded value is known to within
+ * 1 / 2^SUB_BITS of itself no matter its magnitude.
+ */
+class LatencyHistogram
+{
+  public:
+    static const uint32_t SUB_BITS = 5;                     //!< log2 of sub buckets per power of two
+    static const uint32_t SUB_COUNT = 1 << SUB_BITS;        //!< Sub buckets per power of two
+    static const uint32_t BUCKETS = (65 - SUB_BITS) * SUB_COUNT; //!< Buckets covering all of uint64_t
+
+    LatencyHistogram();
+
+    /**
+     * \brief Record one value.
+     * \param value the value
+     */
+    void Record(uint64_t value);
+
+    uint64_t GetCount() const;
+    uint64_t GetMin() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+
+    /**
+     * \brief Get a percentile of the recorded values.
+     * \param percentile percentile in [0, 100]
+     * \return the midpoint of the bucket holding the percentile, zero if empty
+     */
+    uint64_t GetPercentile(double percentile) const;
+
+    /**
+     * \brief Get the non empty buckets.
+     * \return ( lowest value of the bucket, count ) pairs in increasing order
+     */
+    std::vector<std::pair<uint64_t, uint64_t>> GetBuckets() const;
+
+  private:
+    static uint32_t GetIndex(uint64_t value);
+    static uint64_t GetLowest(uint32_t index);
+    static uint64_t GetHighest(uint32_t index);
+
+    std::vector<uint64_t> m_counts; //!< Count per bucket
+    uint64_t m_total;               //!< Number of recorded values
+    uint64_t m_min;                 //!< Smallest recorded value
+    uint64_t m_max;                 //!< Largest recorded value
+    double m_sum;                   //!< Sum of recorded values
+};
+
+/**
+ * \ingroup applications
+ * \brief Per job metrics shared by the workers and switches of a simulation.
+ *
+ * Records the job completion time, the send to AACK latency of every
+ * gradient, goodput, retransmissions and switch fallbacks. The results are
+ * written to the JsonFile and CsvFile files when the simulator is destroyed.
+ */
+class JobStats : public Object
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    JobStats();
+
+    ~JobStats() override;
+
+    /**
+     * \brief Record a gradient sent by a worker, including retransmits.
+     * \param jobId job of the worker
+     * \param bytes payload size
+     */
+    void RecordSend(uint16_t jobId, uint32_t bytes);
+    /**
+     * \brief Record a gradient retransmitted by a worker.
+     * \param jobId job of the worker
+     */
+    void RecordRetransmit(uint16_t jobId);
+    /**
+     * \brief Record a gradient a worker received the AACK of.
+     * \param jobId job of the worker
+     * \param latency time from the first send to the AACK
+     * \param bytes payload size
+     */
+    void RecordAggregation(uint16_t jobId, Time latency, uint32_t bytes);
+    /**
+     * \brief Record a gradient contribution forwarded to the PS by a switch.
+     * \param jobId job of the gradient
+     */
+    void RecordFallback(uint16_t jobId);
+    /**
+     * \brief Record the switch memory a job holds.
+     * \param jobId job id
+     * \param bytes aggregator memory currently held by the job on one switch
+     */
+    void RecordSwitchMemory(uint16_t jobId, uint32_t bytes);
+    /**
+     * \brief Record a new slot looked up in a hash indexed switch.
+     * \param jobId job of the gradient
+     * \param collided whether the first candidate slot was taken
+     * \param found whether a free slot was found
+     */
+    void RecordSlotLookup(uint16_t jobId, bool collided, bool found);
+    /**
+     * \brief Record a slot of a job preempted by a switch for another job.
+     * \param jobId job that lost the slot
+     */
+    void RecordPreemption(uint16_t jobId);
+    /**
+     * \brief Record a contribution arriving after its gradient completed with a quorum.
+     * \param jobId job of the contribution
+     */
+    void RecordLateContribution(uint16_t jobId);
+    /**
+     * \brief Record a worker joining or leaving a job.
+     * \param jobId job whose fan-in changed
+     */
+    void RecordMembershipChange(uint16_t jobId);
+
+    /**
+     * \brief Get the completion time of a job, from its first send to its last AACK.
+     * \param jobId job id
+     * \return the JCT, zero if the job has no AACKed gradient
+     */
+    Time GetJobCompletionTime(uint16_t jobId) const;
+    /**
+     * \brief Get the goodput of a job, AACKed payload bits over its JCT.
+     * \param jobId job id
+     * \return the goodput in bits per second
+     */
+    double GetGoodput(uint16_t jobId) const;
+    /**
+     * \brief Get the share of slot lookups of a job that hit a taken slot first.
+     * \param jobId job id
+     * \return the collision rate, zero without lookups
+     */
+    double GetCollisionRate(uint16_t jobId) const;
+
+    /**
+     * \brief Write the JSON and CSV reports.
+     */
+    void Dump() const;
+
+  private:
+    /// Metrics of one job
+    struct Job
+    {
+        Time start;                 //!< First gradient send
+        Time end;                   //!< Last AACK received
+        bool started = false;       //!< Whether start is set
+        uint64_t sentBytes = 0;     //!< Payload bytes sent, retransmits included
+        uint64_t ackedBytes = 0;    //!< Payload bytes AACKed
+        uint64_t retransmits = 0;   //!< Retransmitted gradients
+        uint64_t fallbacks = 0;     //!< Contributions forwarded to the PS
+        uint32_t memoryPeak = 0;    //!< Most switch aggregator memory held at once
+        uint64_t slotLookups = 0;   //!< New slots looked up in a hash index
+        uint64_t collisions = 0;    //!< Lookups whose first candidate slot was taken
+        uint64_t collisionFallbacks = 0;   //!< Lookups that found no free slot
+        uint64_t preemptions = 0;   //!< Slots flushed to the PS for another job
+        uint64_t lateContributions = 0;   //!< Contributions arriving after a quorum result
+        uint64_t membershipChanges = 0;   //!< Workers that joined or left the job
+        LatencyHistogram latency;   //!< Send to AACK latency in ns
+    };
+
+    /**
+     * \brief Write the JSON report.
+     * \param fileName output file
+     */
+    void DumpJson(std::string fileName) const;
+    /**
+     * \brief Write the CSV report, one row per job.
+     * \param fileName output file
+     */
+    void DumpCsv(std::string fileName) const;
+
+    std::string m_jsonFile;         //!< JSON report file (empty disables it)
+    std::string m_csvFile;          //!< CSV report file (empty disables it)
+    std::map<uint16_t, Job> m_jobs; //!< Metrics per job
+};
+
+} // namespace ns3
+
+#endif /* JOB_STATS_H */
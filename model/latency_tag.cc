@@ -0,0 +1,126 @@
+#include "latency_tag.h"
+
+namespace ns3
+{
+
+NS_OBJECT_ENSURE_REGISTERED(LatencyTag);
+
+TypeId
+LatencyTag::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LatencyTag")
+                            .SetParent<Tag>()
+                            .SetGroupName("Applications")
+                            .AddConstructor<LatencyTag>();
+    return tid;
+}
+
+TypeId
+LatencyTag::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+LatencyTag::LatencyTag()
+    : m_seq(0),
+      m_send(Seconds(0)),
+      m_switchArrival(Seconds(0)),
+      m_slotComplete(Seconds(0)),
+      m_psArrival(Seconds(0))
+{
+}
+
+uint32_t
+LatencyTag::GetSerializedSize() const
+{
+    return sizeof(uint32_t) + 4 * sizeof(uint64_t);
+}
+
+void
+LatencyTag::Serialize(TagBuffer i) const
+{
+    i.WriteU32(m_seq);
+    i.WriteU64(m_send.GetTimeStep());
+    i.WriteU64(m_switchArrival.GetTimeStep());
+    i.WriteU64(m_slotComplete.GetTimeStep());
+    i.WriteU64(m_psArrival.GetTimeStep());
+}
+
+void
+LatencyTag::Deserialize(TagBuffer i)
+{
+    m_seq = i.ReadU32();
+    m_send = TimeStep(i.ReadU64());
+    m_switchArrival = TimeStep(i.ReadU64());
+    m_slotComplete = TimeStep(i.ReadU64());
+    m_psArrival = TimeStep(i.ReadU64());
+}
+
+void
+LatencyTag::Print(std::ostream& os) const
+{
+    os << "seq=" << m_seq << " send=" << m_send << " switch=" << m_switchArrival
+       << " slot=" << m_slotComplete << " ps=" << m_psArrival;
+}
+
+void
+LatencyTag::SetSeq(uint32_t seq)
+{
+    m_seq = seq;
+}
+
+uint32_t
+LatencyTag::GetSeq() const
+{
+    return m_seq;
+}
+
+void
+LatencyTag::SetSend(Time t)
+{
+    m_send = t;
+}
+
+Time
+LatencyTag::GetSend() const
+{
+    return m_send;
+}
+
+void
+LatencyTag::SetSwitchArrival(Time t)
+{
+    m_switchArrival = t;
+}
+
+Time
+LatencyTag::GetSwitchArrival() const
+{
+    return m_switchArrival;
+}
+
+void
+LatencyTag::SetSlotComplete(Time t)
+{
+    m_slotComplete = t;
+}
+
+Time
+LatencyTag::GetSlotComplete() const
+{
+    return m_slotComplete;
+}
+
+void
+LatencyTag::SetPsArrival(Time t)
+{
+    m_psArrival = t;
+}
+
+Time
+LatencyTag::GetPsArrival() const
+{
+    return m_psArrival;
+}
+
+} // namespace ns3
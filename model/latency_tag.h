@@ -0,0 +1,56 @@
+#ifndef LATENCY_TAG_H
+#define LATENCY_TAG_H
+
+#include "ns3/nstime.h"
+#include "ns3/tag.h"
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Timestamps of one gradient along its aggregation path.
+ *
+ * The worker stamps the send time, the switch its arrival and the slot
+ * completion, the PS its arrival. GACKs and AACKs carry the tag back to the
+ * worker, which derives the per-stage latency breakdown. Unset stamps are
+ * zero.
+ */
+class LatencyTag : public Tag
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(TagBuffer i) const override;
+    void Deserialize(TagBuffer i) override;
+    void Print(std::ostream& os) const override;
+
+    LatencyTag();
+
+    void SetSeq(uint32_t seq);
+    uint32_t GetSeq() const;
+    void SetSend(Time t);
+    Time GetSend() const;
+    void SetSwitchArrival(Time t);
+    Time GetSwitchArrival() const;
+    void SetSlotComplete(Time t);
+    Time GetSlotComplete() const;
+    void SetPsArrival(Time t);
+    Time GetPsArrival() const;
+
+  private:
+    uint32_t m_seq;         //!< Gradient seq the stamps belong to
+    Time m_send;            //!< Worker send time
+    Time m_switchArrival;   //!< Arrival at the aggregation switch
+    Time m_slotComplete;    //!< Completion of the switch slot
+    Time m_psArrival;       //!< Arrival at the PS
+};
+
+} // namespace ns3
+
+#endif /* LATENCY_TAG_H */
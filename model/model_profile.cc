@@ -0,0 +1,128 @@
+#include "model_profile.h"
+
+#include <map>
+
+namespace ns3
+{
+
+uint64_t
+ModelProfile::GetBytes() const
+{
+    uint64_t bytes = 0;
+    for (const LayerProfile& layer : layers)
+    {
+        bytes += layer.bytes;
+    }
+    return bytes;
+}
+
+/**
+ * \brief Make a layer profile.
+ * \param name layer name
+ * \param params number of fp32 parameters
+ * \param backwardUs backward compute time in microseconds
+ * \return the layer profile
+ */
+static LayerProfile
+Layer(const std::string& name, uint64_t params, int64_t backwardUs)
+{
+    return LayerProfile{name, params * 4, MicroSeconds(backwardUs)};
+}
+
+/**
+ * \brief Build the built in profiles.
+ *
+ * Parameter counts are exact for the reference architectures. Compute
+ * times split the measured iteration time over the layers by their share
+ * of the FLOPs.
+ *
+ * \return the profiles by name
+ */
+static std::map<std::string, ModelProfile>
+BuildModelProfiles()
+{
+    std::map<std::string, ModelProfile> profiles;
+
+    // ResNet-50 by bottleneck block, 25.6M parameters, batch 32 at 224x224
+    ModelProfile resnet{"ResNet-50", 32, MilliSeconds(30), {}};
+    resnet.layers.push_back(Layer("conv1", 9536, 1700));
+    resnet.layers.push_back(Layer("layer1.0", 75008, 3400));
+    resnet.layers.push_back(Layer("layer1.1", 70400, 3300));
+    resnet.layers.push_back(Layer("layer1.2", 70400, 3300));
+    resnet.layers.push_back(Layer("layer2.0", 379392, 3750));
+    for (int i = 1; i < 4; i++)
+    {
+        resnet.layers.push_back(Layer("layer2." + std::to_string(i), 280064, 3750));
+    }
+    resnet.layers.push_back(Layer("layer3.0", 1512448, 3600));
+    for (int i = 1; i < 6; i++)
+    {
+        resnet.layers.push_back(Layer("layer3." + std::to_string(i), 1117184, 3600));
+    }
+    resnet.layers.push_back(Layer("layer4.0", 6039552, 3900));
+    for (int i = 1; i < 3; i++)
+    {
+        resnet.layers.push_back(Layer("layer4." + std::to_string(i), 4462592, 3900));
+    }
+    resnet.layers.push_back(Layer("fc", 2049000, 30));
+    profiles[resnet.name] = resnet;
+
+    // VGG-16, 138.4M parameters, batch 32 at 224x224
+    ModelProfile vgg{"VGG-16", 32, MilliSeconds(47), {}};
+    vgg.layers.push_back(Layer("conv1_1", 1792, 520));
+    vgg.layers.push_back(Layer("conv1_2", 36928, 11100));
+    vgg.layers.push_back(Layer("conv2_1", 73856, 5600));
+    vgg.layers.push_back(Layer("conv2_2", 147584, 11100));
+    vgg.layers.push_back(Layer("conv3_1", 295168, 5600));
+    vgg.layers.push_back(Layer("conv3_2", 590080, 11100));
+    vgg.layers.push_back(Layer("conv3_3", 590080, 11100));
+    vgg.layers.push_back(Layer("conv4_1", 1180160, 5600));
+    vgg.layers.push_back(Layer("conv4_2", 2359808, 11100));
+    vgg.layers.push_back(Layer("conv4_3", 2359808, 11100));
+    vgg.layers.push_back(Layer("conv5_1", 2359808, 2800));
+    vgg.layers.push_back(Layer("conv5_2", 2359808, 2800));
+    vgg.layers.push_back(Layer("conv5_3", 2359808, 2800));
+    vgg.layers.push_back(Layer("fc6", 102764544, 620));
+    vgg.layers.push_back(Layer("fc7", 16781312, 100));
+    vgg.layers.push_back(Layer("fc8", 4097000, 30));
+    profiles[vgg.name] = vgg;
+
+    // BERT-Base by encoder layer, 109.5M parameters, batch 32 at sequence length 128
+    ModelProfile bert{"BERT-Base", 32, MilliSeconds(70), {}};
+    bert.layers.push_back(Layer("embeddings", 23837184, 1000));
+    for (int i = 0; i < 12; i++)
+    {
+        bert.layers.push_back(Layer("encoder." + std::to_string(i), 7087872, 11500));
+    }
+    bert.layers.push_back(Layer("pooler", 590592, 100));
+    profiles[bert.name] = bert;
+
+    // GPT-2 small by transformer block, 124.4M parameters, batch 8 at sequence length 1024.
+    // The LM head is tied to the token embedding, its backward time is with the final norm.
+    ModelProfile gpt{"GPT-2", 8, MilliSeconds(140), {}};
+    gpt.layers.push_back(Layer("embeddings", 39383808, 2000));
+    for (int i = 0; i < 12; i++)
+    {
+        gpt.layers.push_back(Layer("h." + std::to_string(i), 7087872, 20000));
+    }
+    gpt.layers.push_back(Layer("ln_f", 1536, 40000));
+    profiles[gpt.name] = gpt;
+
+    return profiles;
+}
+
+const ModelProfile*
+GetModelProfile(const std::string& name)
+{
+    static const std::map<std::string, ModelProfile> profiles = BuildModelProfiles();
+    auto it = profiles.find(name);
+    return it == profiles.end() ? nullptr : &it->second;
+}
+
+std::vector<std::string>
+GetModelProfileNames()
+{
+    return {"ResNet-50", "VGG-16", "BERT-Base", "GPT-2"};
+}
+
+} // namespace ns3
@@ -0,0 +1,57 @@
+#ifndef MODEL_PROFILE_H
+#define MODEL_PROFILE_H
+
+#include "ns3/nstime.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Gradient size and backward compute time of one layer (or block).
+ */
+struct LayerProfile
+{
+    std::string name;   //!< Layer name
+    uint64_t bytes;     //!< fp32 gradient size
+    Time backward;      //!< Backward compute time of the layer
+};
+
+/**
+ * \brief Training iteration profile of a model.
+ *
+ * Times are for one data parallel worker at the reference batch size on a
+ * V100 class GPU in fp32. Layers are listed input to output, so gradients
+ * become ready in reverse order during the backward pass.
+ */
+struct ModelProfile
+{
+    std::string name;                  //!< Model name
+    uint32_t batchSize;                //!< Reference per worker batch size
+    Time forward;                      //!< Forward pass time
+    std::vector<LayerProfile> layers;  //!< Layers, input to output
+
+    /**
+     * \return the gradient bytes of one iteration
+     */
+    uint64_t GetBytes() const;
+};
+
+/**
+ * \brief Get a built in model profile.
+ * \param name "ResNet-50", "VGG-16", "BERT-Base" or "GPT-2"
+ * \return the profile, nullptr for unknown names
+ */
+const ModelProfile* GetModelProfile(const std::string& name);
+
+/**
+ * \return the names of the built in model profiles
+ */
+std::vector<std::string> GetModelProfileNames();
+
+} // namespace ns3
+
+#endif /* MODEL_PROFILE_H */
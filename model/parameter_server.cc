@@ -1,5 +1,6 @@
 #include "parameter_server.h"
 
+#include "ns3/abort.h"
 #include "ns3/address-utils.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
@@ -13,6 +14,8 @@
 #include "ns3/socket.h"
 #include "ns3/udp-socket.h"
 #include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/pointer.h"
 
 #include <sstream>
 #include <algorithm>
@@ -48,6 +51,77 @@ ParameterServer::GetTypeId()
                           TimeValue(Seconds(1.0)),
                           MakeTimeAccessor(&ParameterServer::m_interval),
                           MakeTimeChecker())
+            .AddAttribute("MaxParts",
+                          "Number of workers contributing to one gradient",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&ParameterServer::m_maxParts),
+                          MakeUintegerChecker<uint16_t>(1))
+            .AddAttribute("Quorum",
+                          "Parts a gradient completes with (zero waits for MaxParts). A switch "
+                          "result carrying a smaller quorum completes with that one",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&ParameterServer::m_quorum),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("LatePolicy",
+                          "What happens to the parts arriving after a quorum. Drop rescales "
+                          "quorum sums to MaxParts parts, Fold adds the late parts to the next "
+                          "update applied instead",
+                          EnumValue(LATE_DROP),
+                          MakeEnumAccessor<LatePolicy>(&ParameterServer::m_latePolicy),
+                          MakeEnumChecker(LATE_DROP, "Drop",
+                                          LATE_FOLD, "Fold"))
+            .AddAttribute("DataType",
+                          "Element type of the gradient values",
+                          EnumValue(INT32),
+                          MakeEnumAccessor<AggregationDataType>(&ParameterServer::m_dataType),
+                          MakeEnumChecker(INT32, "Int32",
+                                          FLOAT32, "Float32",
+                                          FLOAT16, "Float16",
+                                          BFLOAT16, "BFloat16"))
+            .AddAttribute("ReduceOp",
+                          "Reduction applied element wise to the gradient values",
+                          EnumValue(REDUCE_SUM),
+                          MakeEnumAccessor<ReduceOp>(&ParameterServer::m_reduceOp),
+                          MakeEnumChecker(REDUCE_SUM, "Sum",
+                                          REDUCE_MAX, "Max",
+                                          REDUCE_MIN, "Min"))
+            .AddAttribute("ProcessingDelay",
+                          "Time the PS spends merging one received contribution",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&ParameterServer::m_processingDelay),
+                          MakeTimeChecker())
+            .AddAttribute("ShardId",
+                          "Index of this PS among the shards of a job",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&ParameterServer::m_shardId),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("NumShards",
+                          "Number of PS shards a job is partitioned over",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&ParameterServer::m_numShards),
+                          MakeUintegerChecker<uint16_t>(1))
+            .AddAttribute("ShardSize",
+                          "Number of consecutive gradient seqs mapped to one PS shard",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&ParameterServer::m_shardSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("AackBatchSize",
+                          "Number of completed gradients acknowledged by one AACK "
+                          "(1 sends an AACK per gradient)",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&ParameterServer::m_aackBatchSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("AackDelay",
+                          "Max time a partial AACK batch is held before it is sent, "
+                          "required when AackBatchSize is above 1",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&ParameterServer::m_aackDelay),
+                          MakeTimeChecker())
+            .AddAttribute("EventTrace",
+                          "Binary event log the PS records to",
+                          PointerValue(),
+                          MakePointerAccessor(&ParameterServer::m_eventTrace),
+                          MakePointerChecker<EventTrace>())
             .AddAttribute("RemoteAddress",
                           "The destination Address of the outbound packets",
                           AddressValue(),
@@ -69,6 +143,10 @@ ParameterServer::GetTypeId()
                           UintegerValue(100),
                           MakeUintegerAccessor(&ParameterServer::SetDataSize, &ParameterServer::GetDataSize),
                           MakeUintegerChecker<uint32_t>())
+            .AddTraceSource("Update",
+                            "A complete gradient has been applied to the model",
+                            MakeTraceSourceAccessor(&ParameterServer::m_updateTrace),
+                            "ns3::ParameterServer::UpdateTracedCallback")
             .AddTraceSource("Tx",
                             "A new packet is created and is sent",
                             MakeTraceSourceAccessor(&ParameterServer::m_txTrace),
@@ -97,6 +175,7 @@ ParameterServer::ParameterServer()
     m_data = nullptr;
     m_dataSize = 0;
     m_gradientCount = 0;
+    m_busyUntil = Seconds(0);
 }
 
 ParameterServer::~ParameterServer()
@@ -129,6 +208,10 @@ ParameterServer::StartApplication()
 {
     NS_LOG_FUNCTION(this);
 
+    // Without the timer the tail of a job, or a batch wider than the window, is never acknowledged
+    NS_ABORT_MSG_IF(m_aackBatchSize > 1 && m_aackDelay.IsZero(), "AackBatchSize above 1 needs an AackDelay");
+    m_aggregator = CreateAggregator(m_dataType, m_reduceOp);
+
     if (!m_socket)
     {
         TypeId tid = TypeId::LookupByName("ns3::UdpSocketFactory");
@@ -171,6 +254,16 @@ ParameterServer::StopApplication()
     }
 
     Simulator::Cancel(m_sendEvent);
+    for (auto& timer : m_aackTimer)
+    {
+        Simulator::Cancel(timer.second);
+    }
+    // Queued contributions would answer on the closed socket
+    for (EventId& event : m_aggregateEvents)
+    {
+        Simulator::Cancel(event);
+    }
+    m_aggregateEvents.clear();
 }
 
 void
@@ -289,30 +382,419 @@ ParameterServer::HandleRead(Ptr<Socket> socket)
         m_rxTrace(packet);
         m_rxTraceWithAddresses(packet, from, localAddress);
 
-        uint8_t read_buffer[1000];
-        packet->CopyData(read_buffer, packet->GetSize()); // Copy data from packet
-        std::string read_data(read_buffer, read_buffer+packet->GetSize()); // Read data
+        std::vector<uint8_t> read_buffer(packet->GetSize() + 1, 0);
+        packet->CopyData(read_buffer.data(), packet->GetSize()); // Copy data from packet
+        std::string read_data(reinterpret_cast<char*>(read_buffer.data())); // Read header
         NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS received : " << read_data);
         std::vector<std::string> pktGradient = split_string(read_data, (char *)",");
+        // Values follow the header terminator
+        std::vector<uint8_t> values;
+        if (read_data.size() + 1 < packet->GetSize()) {
+            values.assign(read_buffer.begin() + read_data.size() + 1, read_buffer.end() - 1);
+        }
         
         // Broadcast to workers
         if (pktGradient[0] == "AACK") {
+            continue;
+        }
+
+        if (pktGradient[0] == "JOIN" || pktGradient[0] == "LEAVE") {
+            HandleMembership(pktGradient, from);
+            continue;
+        }
+
+        LatencyTag path;
+        bool tagged = packet->PeekPacketTag(path);
+        path.SetPsArrival(Simulator::Now());
+
+        // Contributions are merged one at a time by the aggregation engine
+        if (m_processingDelay.IsZero()) {
+            Aggregate(pktGradient, values, path, tagged);
+            continue;
+        }
+        m_busyUntil = std::max(m_busyUntil, Simulator::Now()) + m_processingDelay;
+        while (!m_aggregateEvents.empty() && m_aggregateEvents.front().IsExpired()) {
+            m_aggregateEvents.pop_front();
+        }
+        m_aggregateEvents.push_back(Simulator::Schedule(m_busyUntil - Simulator::Now(), &ParameterServer::Aggregate,
+                                                        this, pktGradient, values, path, tagged));
+    }
+}
+
+void
+ParameterServer::Aggregate(std::vector<std::string> pktGradient, std::vector<uint8_t> values, LatencyTag path, bool tagged)
+{
+    NS_LOG_FUNCTION(this);
+
+    std::string jobId;
+    uint32_t seq;
+    std::set<uint16_t> parts;
+    double scale = 1.0;
+    uint32_t pairs = 0;
+    uint16_t quorum = 0;
+    if (pktGradient[0] == "RESULT" || pktGradient[0] == "PARTIAL") {
+        // Format : RESULT,jobId,seq,bitmap,scale,quorum or PARTIAL,jobId,seq,bitmap[,scale]
+        jobId = pktGradient[1];
+        seq = std::stoul(pktGradient[2]);
+        if (pktGradient.size() > 4) {
+            scale = std::stod(pktGradient[4]);
+        }
+        if (pktGradient[0] == "RESULT" && pktGradient.size() > 5) {
+            quorum = std::stoi(pktGradient[5]);
+        }
+        if (pktGradient.size() > 3) {
+            parts = decode_bitmap(pktGradient[3]);
+        }
+        else {
+            // Result without contributor bitmap covers every part
+            parts = GetExpectedParts(jobId, seq);
+        }
+    }
+    else {
+        // Format : jobId,partId,gradientId[,scale[,pairs]]
+        jobId = pktGradient[0];
+        seq = std::stoul(pktGradient[2]);
+        parts.insert(std::stoi(pktGradient[1]));
+        if (pktGradient.size() > 3) {
+            scale = std::stod(pktGradient[3]);
+        }
+        if (pktGradient.size() > 4) {
+            pairs = std::stoul(pktGradient[4]);
+        }
+    }
+
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end()) {
+        it = m_jobs.emplace(jobId, JobState()).first;
+        it->second.nextUpdate = NextOwnedSeq(0);
+    }
+    JobState& job = it->second;
+    uint32_t elementSize = m_aggregator->GetElementSize();
+    if (static_cast<uint64_t>(pairs) * (sizeof(uint32_t) + elementSize) > values.size()) {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS dropped truncated sparse gradient " << jobId << ',' << seq
+                    << " ( " << pairs << " pairs in " << values.size() << " bytes )");
+        return;
+    }
+    // Indices absent from a sparse block are zeros, only a sum leaves them out unchanged
+    NS_ABORT_MSG_IF(pairs > 0 && m_reduceOp != REDUCE_SUM, "Sparse gradients (TopK) need ReduceOp Sum");
+    auto late = job.late.find(seq);
+    if (late != job.late.end() && !parts.empty() &&
+        std::includes(late->second.begin(), late->second.end(), parts.begin(), parts.end())) {
+        for (uint16_t part : parts) {
+            late->second.erase(part);
+        }
+        if (late->second.empty()) {
+            job.late.erase(late);
+        }
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS folded late " << pktGradient[0] << " for " << jobId << ',' << seq);
+        std::vector<uint8_t> encoded = values;
+        if (pairs > 0) {
+            uint32_t lastIndex;
+            memcpy(&lastIndex, values.data() + (pairs - 1) * (sizeof(uint32_t) + elementSize), sizeof(uint32_t));
+            encoded.assign((lastIndex + 1) * elementSize, 0);
+            m_aggregator->MergeSparse(encoded.data(), values.data(), pairs);
+        }
+        std::vector<double> lateValues(encoded.size() / elementSize);
+        m_aggregator->Decode(encoded.data(), lateValues.size(), scale, lateValues.data());
+        // Not applied yet, the late part still makes its own update
+        auto ready = job.ready.find(seq);
+        std::vector<double>& target = ready != job.ready.end() ? ready->second : job.carry;
+        target.resize(std::max(target.size(), lateValues.size()), 0);
+        for (size_t i = 0; i < lateValues.size(); i++) {
+            target[i] += lateValues[i];
+        }
+        QueueAack(jobId, seq);
+        return;
+    }
+    if (seq < job.nextUpdate || job.ready.count(seq)) {
+        // Already complete, the AACK may have been lost so acknowledge again
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS duplicate for completed " << jobId << ',' << seq);
+        QueueAack(jobId, seq);
+        return;
+    }
+
+    auto ret = job.accumulators.insert(std::pair<uint32_t, Accumulator>(seq, Accumulator()));
+    Accumulator& acc = ret.first->second;
+    for (uint16_t part : parts) {
+        if (acc.parts.count(part)) {
+            // A partial aggregate cannot be split, so any overlap drops the whole contribution
+            NS_LOG_INFO(Simulator::Now().As(Time::S) << " ERROR: PS part duplicate found " << jobId << ',' << seq);
             return;
         }
+    }
+    acc.parts.insert(parts.begin(), parts.end());
+    if (quorum > 0 && (acc.quorum == 0 || quorum < acc.quorum)) {
+        acc.quorum = quorum;
+    }
+    if (ret.second) {
+        acc.scale = scale;
+    }
+    else if (scale < acc.scale) {
+        // Workers pick their own scale, the accumulator moves to the smaller one so no contribution saturates
+        m_aggregator->Rescale(acc.values.data(), acc.values.size() / elementSize, scale / acc.scale);
+        acc.scale = scale;
+    }
+    else if (scale > acc.scale) {
+        // Contribution quantized finer than the accumulator, bring it to the accumulator scale
+        if (pairs > 0) {
+            uint32_t lastIndex;
+            memcpy(&lastIndex, values.data() + (pairs - 1) * (sizeof(uint32_t) + elementSize), sizeof(uint32_t));
+            std::vector<uint8_t> dense((lastIndex + 1) * elementSize, 0);
+            m_aggregator->MergeSparse(dense.data(), values.data(), pairs);
+            values.swap(dense);
+            pairs = 0;
+        }
+        m_aggregator->Rescale(values.data(), values.size() / elementSize, acc.scale / scale);
+    }
+    if (pairs > 0) {
+        // Sparse pairs are in index order, the last one bounds the dense accumulator
+        uint32_t lastIndex;
+        memcpy(&lastIndex, values.data() + (pairs - 1) * (sizeof(uint32_t) + elementSize), sizeof(uint32_t));
+        acc.values.resize(std::max<size_t>(acc.values.size(), (lastIndex + 1) * elementSize), 0);
+        m_aggregator->MergeSparse(acc.values.data(), values.data(), pairs);
+    }
+    else if (ret.second) {
+        acc.values = values;
+    }
+    else {
+        acc.values.resize(std::max(acc.values.size(), values.size()), 0);
+        m_aggregator->Merge(acc.values.data(), values.data(), values.size() / elementSize);
+    }
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS merged " << pktGradient[0] << " into " << jobId << ',' << seq
+                << " ( " << acc.parts.size() << " / " << GetExpectedParts(jobId, seq).size() << " )");
+    if (m_eventTrace) {
+        m_eventTrace->Record(EVENT_PS_RX, GetNode()->GetId(), std::stoi(jobId), seq, values.size());
+    }
+
+    TryComplete(jobId, seq, path, tagged);
+}
 
+bool
+ParameterServer::TryComplete(std::string jobId, uint32_t seq, LatencyTag path, bool tagged)
+{
+    NS_LOG_FUNCTION(this << jobId << seq);
+    JobState& job = m_jobs[jobId];
+    Accumulator& acc = job.accumulators[seq];
+    std::set<uint16_t> expected = GetExpectedParts(jobId, seq);
+    std::set<uint16_t> missing;
+    for (uint16_t part : expected) {
+        if (!acc.parts.count(part)) {
+            missing.insert(part);
+        }
+    }
+    // Parts of a worker that left still add to the values, but no longer to the count
+    size_t quorum = (m_quorum == 0 || m_quorum > expected.size()) ? expected.size() : m_quorum;
+    if (acc.quorum > 0 && acc.quorum < quorum) {
+        // A switch already completed the gradient without the missing parts
+        quorum = acc.quorum;
+    }
+    if (expected.size() - missing.size() < quorum) {
+        return false;
+    }
+    uint32_t elementSize = m_aggregator->GetElementSize();
+    std::vector<double> update(acc.values.size() / elementSize);
+    m_aggregator->Decode(acc.values.data(), update.size(), acc.scale, update.data());
+    if (!missing.empty() && m_latePolicy == LATE_FOLD) {
+        // Dropped late parts are handled as duplicates, only folded ones are remembered
+        job.late[seq] = missing;
+    }
+    else if (!missing.empty() && !acc.parts.empty()) {
+        if (m_reduceOp == REDUCE_SUM) {
+            // Scale the quorum sum up to the expected sum of every part
+            double factor = static_cast<double>(expected.size()) / acc.parts.size();
+            for (double& value : update) {
+                value *= factor;
+            }
+        }
+    }
+    job.accumulators.erase(seq);
+    job.ready[seq] = update;
+    if (tagged) {
+        m_aackPath[jobId] = path;
+    }
+    QueueAack(jobId, seq);
+    ApplyUpdates(jobId);
+    return true;
+}
+
+void
+ParameterServer::HandleMembership(const std::vector<std::string>& pktGradient, Address from)
+{
+    NS_LOG_FUNCTION(this << pktGradient[0] << from);
+    // Changes are applied in epoch order, a lost one is resent by the switch before any later one applies
+    std::string jobId = pktGradient[1];
+    uint32_t& applied = m_membershipEpoch[jobId];
+    if (std::stoul(pktGradient.back()) == applied + 1) {
+        applied++;
+        ApplyMembership(pktGradient);
+    }
+    // Format : MACK,jobId,epoch with epoch the last change applied
+    SetFill("MACK," + jobId + ',' + std::to_string(applied));
+    m_socket->SendTo(Create<Packet>(m_data, m_dataSize), 0, from);
+}
+
+void
+ParameterServer::ApplyMembership(const std::vector<std::string>& pktGradient)
+{
+    NS_LOG_FUNCTION(this << pktGradient[0]);
+    std::string jobId = pktGradient[1];
+    uint16_t partId = std::stoi(pktGradient[2]);
+    if (pktGradient[0] == "JOIN") {
+        // Format : JOIN,jobId,partId,fromSeq,epoch
+        GetMembers(jobId).insert(std::make_pair(partId, std::stoul(pktGradient[3])));
+        return;
+    }
+
+    // Format : LEAVE,jobId,partId,epoch
+    if (GetMembers(jobId).erase(partId) == 0) {
+        return;
+    }
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end()) {
+        return;
+    }
+    JobState& job = it->second;
+    // Folded parts still due from the worker will not come
+    for (auto late = job.late.begin(); late != job.late.end();) {
+        late->second.erase(partId);
+        late = late->second.empty() ? job.late.erase(late) : std::next(late);
+    }
+    std::vector<uint32_t> seqs;
+    for (const auto& acc : job.accumulators) {
+        seqs.push_back(acc.first);
+    }
+    for (uint32_t seq : seqs) {
+        if (TryComplete(jobId, seq, LatencyTag(), false)) {
+            NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS completed " << jobId << ',' << seq
+                        << " without part " << partId);
+        }
+    }
+}
+
+std::map<uint16_t, uint32_t>&
+ParameterServer::GetMembers(std::string jobId)
+{
+    auto it = m_members.find(jobId);
+    if (it == m_members.end()) {
+        // A static job becomes elastic, parts 0 .. MaxParts - 1 were there from the start
+        it = m_members.emplace(jobId, std::map<uint16_t, uint32_t>()).first;
+        for (uint16_t part = 0; part < m_maxParts; part++) {
+            it->second[part] = 0;
+        }
+    }
+    return it->second;
+}
+
+std::set<uint16_t>
+ParameterServer::GetExpectedParts(std::string jobId, uint32_t seq) const
+{
+    std::set<uint16_t> expected;
+    auto members = m_members.find(jobId);
+    if (members == m_members.end()) {
+        for (uint16_t part = 0; part < m_maxParts; part++) {
+            expected.insert(part);
+        }
+        return expected;
+    }
+    for (const auto& member : members->second) {
+        if (member.second <= seq) {
+            expected.insert(member.first);
+        }
+    }
+    return expected;
+}
+
+void
+ParameterServer::ApplyUpdates(std::string jobId)
+{
+    NS_LOG_FUNCTION(this << jobId);
+    JobState& job = m_jobs[jobId];
+    // Out of order completions wait until every earlier seq has been applied
+    while (!job.ready.empty() && job.ready.begin()->first == job.nextUpdate) {
+        std::vector<double>& update = job.ready.begin()->second;
+        if (!job.carry.empty()) {
+            // Late parts of applied updates fold into this one
+            update.resize(std::max(update.size(), job.carry.size()), 0);
+            for (size_t i = 0; i < job.carry.size(); i++) {
+                update[i] += job.carry[i];
+            }
+            job.carry.clear();
+        }
         m_gradientCount++;
-        // IMPLEMENT BROADCAST AACK
-        SetFill("AACK," + pktGradient[1] + ',' + pktGradient[2]);
-        Ptr<Packet> pktAACK;
-        pktAACK = Create<Packet>(m_data, m_dataSize);
-        Address dstAddress = InetSocketAddress(Ipv4Address("255.255.255.255"), m_peerPort);
-        socket->SendTo(pktAACK, 0, dstAddress);
-        if (InetSocketAddress::IsMatchingType(dstAddress))
-        {
-            NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS sent AACK ( "
-                        << InetSocketAddress::ConvertFrom(dstAddress).GetIpv4() << " port "
-                        << InetSocketAddress::ConvertFrom(dstAddress).GetPort() << " )");
+        m_updateTrace(std::stoi(jobId), job.nextUpdate, job.ready.begin()->second);
+        job.ready.erase(job.ready.begin());
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS applied update " << jobId << ',' << job.nextUpdate);
+        if (m_eventTrace) {
+            m_eventTrace->Record(EVENT_PS_UPDATE, GetNode()->GetId(), std::stoi(jobId), job.nextUpdate, 0);
         }
+        job.nextUpdate = NextOwnedSeq(job.nextUpdate + 1);
+    }
+}
+
+uint32_t
+ParameterServer::NextOwnedSeq(uint32_t seq) const
+{
+    // Contiguous ranges of ShardSize seqs are assigned round robin over the shards
+    uint32_t range = seq / m_shardSize;
+    uint32_t owner = range % m_numShards;
+    if (owner == m_shardId)
+    {
+        return seq;
+    }
+    range += (m_shardId + m_numShards - owner) % m_numShards;
+    return range * m_shardSize;
+}
+
+void
+ParameterServer::QueueAack(std::string jobId, uint32_t seq)
+{
+    NS_LOG_FUNCTION(this << jobId << seq);
+    std::set<uint32_t>& pending = m_aackPending[jobId];
+    pending.insert(seq);
+
+    if (pending.size() >= m_aackBatchSize)
+    {
+        SendAack(jobId);
+    }
+    else if (!m_aackDelay.IsZero() && m_aackTimer[jobId].IsExpired())
+    {
+        m_aackTimer[jobId] = Simulator::Schedule(m_aackDelay, &ParameterServer::SendAack, this, jobId);
+    }
+}
+
+void
+ParameterServer::SendAack(std::string jobId)
+{
+    NS_LOG_FUNCTION(this << jobId);
+    Simulator::Cancel(m_aackTimer[jobId]);
+    std::set<uint32_t>& pending = m_aackPending[jobId];
+    if (pending.empty())
+    {
+        return;
+    }
+
+    // Format : AACK,jobId,range[,range...] with each range either seq or first-last
+    SetFill("AACK," + jobId + ',' + encode_ranges(pending));
+    if (m_eventTrace)
+    {
+        m_eventTrace->Record(EVENT_PS_AACK, GetNode()->GetId(), std::stoi(jobId), *pending.rbegin(), m_dataSize);
+    }
+    pending.clear();
+    Ptr<Packet> pktAACK;
+    pktAACK = Create<Packet>(m_data, m_dataSize);
+    auto path = m_aackPath.find(jobId);
+    if (path != m_aackPath.end())
+    {
+        pktAACK->AddPacketTag(path->second);
+        m_aackPath.erase(path);
+    }
+    Address dstAddress = InetSocketAddress(Ipv4Address("255.255.255.255"), m_peerPort);
+    m_socket->SendTo(pktAACK, 0, dstAddress);
+    if (InetSocketAddress::IsMatchingType(dstAddress))
+    {
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " PS sent AACK ( "
+                    << InetSocketAddress::ConvertFrom(dstAddress).GetIpv4() << " port "
+                    << InetSocketAddress::ConvertFrom(dstAddress).GetPort() << " )");
     }
 }
 
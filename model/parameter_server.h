@@ -7,6 +7,16 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
+#include "ns3/aggregator.h"
+#include "ns3/latency_tag.h"
+#include "ns3/event_trace.h"
+#include "ns3/protocol_mode.h"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace ns3
 {
@@ -113,7 +123,15 @@ class ParameterServer : public Application
      * \param dataSize The desired size of the final echo data.
      */
     void SetFill(uint8_t* fill, uint32_t fillSize, uint32_t dataSize);
-    
+
+    /**
+     * TracedCallback signature for model updates.
+     *
+     * \param [in] jobId job of the update
+     * \param [in] seq gradient seq applied to the model
+     * \param [in] values decoded aggregated values
+     */
+    typedef void (*UpdateTracedCallback)(uint16_t jobId, uint32_t seq, const std::vector<double>& values);
 
   private:
     void StartApplication() override;
@@ -138,6 +156,102 @@ class ParameterServer : public Application
      */
     void HandleRead(Ptr<Socket> socket);
 
+    /**
+     * \brief Queue a completed gradient for the next AACK of its job.
+     * \param jobId job of the gradient
+     * \param seq gradient seq completed
+     */
+    void QueueAack(std::string jobId, uint32_t seq);
+
+    /**
+     * \brief Broadcast one AACK covering every queued gradient of a job.
+     * \param jobId job to acknowledge
+     */
+    void SendAack(std::string jobId);
+
+    /**
+     * \brief Merge a contribution into the accumulator of its gradient.
+     *
+     * Contributions are either raw dense or sparse gradients forwarded by a
+     * switch (jobId,partId,seq), partial aggregates flushed by a switch
+     * (PARTIAL,jobId,seq,bitmap) or complete results (RESULT,jobId,seq,bitmap).
+     *
+     * \param pktGradient the split packet header fields
+     * \param values the encoded values following the header
+     * \param path path stamps of the contribution, returned with the AACK
+     * \param tagged whether the contribution carried path stamps
+     */
+    void Aggregate(std::vector<std::string> pktGradient, std::vector<uint8_t> values, LatencyTag path, bool tagged);
+
+    /**
+     * \brief Complete the accumulator of a gradient if enough parts are merged.
+     *
+     * The accumulator completes with Quorum of the expected parts, or every
+     * one when there are fewer. Its update then waits for the earlier seqs.
+     *
+     * \param jobId job of the gradient
+     * \param seq gradient seq
+     * \param path path stamps returned with the AACK
+     * \param tagged whether path holds stamps
+     * \return true if the gradient completed
+     */
+    bool TryComplete(std::string jobId, uint32_t seq, LatencyTag path, bool tagged);
+
+    /**
+     * \brief Handle a membership change sent by the switch.
+     *
+     * Changes end with the epoch of their job and are applied in epoch
+     * order. Every change is answered with MACK,jobId,epoch carrying the last
+     * epoch applied, so the switch resends the ones that were lost.
+     *
+     * \param pktGradient the split packet header fields
+     * \param from switch address
+     */
+    void HandleMembership(const std::vector<std::string>& pktGradient, Address from);
+
+    /**
+     * \brief Apply a JOIN,jobId,partId,fromSeq,epoch or LEAVE,jobId,partId,epoch.
+     *
+     * After a LEAVE every accumulator of the job is checked again, the ones
+     * only waiting for the worker complete.
+     *
+     * \param pktGradient the split packet header fields
+     */
+    void ApplyMembership(const std::vector<std::string>& pktGradient);
+
+    /**
+     * \brief Get the member table of a job.
+     *
+     * A job without a table gets parts 0 .. MaxParts - 1 from seq zero, so
+     * its static workers stay members once the first change comes in.
+     *
+     * \param jobId job id
+     * \return the first seq of every member
+     */
+    std::map<uint16_t, uint32_t>& GetMembers(std::string jobId);
+
+    /**
+     * \brief Get the parts a seq of a job waits for.
+     * \param jobId job id
+     * \param seq gradient seq
+     * \return the members that joined at or before seq, or parts 0 .. MaxParts - 1
+     *         for a job without members
+     */
+    std::set<uint16_t> GetExpectedParts(std::string jobId, uint32_t seq) const;
+
+    /**
+     * \brief Apply every complete gradient of a job that is next in seq order.
+     * \param jobId job to update
+     */
+    void ApplyUpdates(std::string jobId);
+
+    /**
+     * \brief Get the first seq owned by this shard that is not below seq.
+     * \param seq first candidate seq
+     * \return the owned seq
+     */
+    uint32_t NextOwnedSeq(uint32_t seq) const;
+
     uint32_t m_count; //!< Maximum number of packets the application will send
     Time m_interval;  //!< Packet inter-send time
     uint32_t m_size;  //!< Size of the sent packet
@@ -156,8 +270,57 @@ class ParameterServer : public Application
     uint16_t m_port;       //!< Port to listen for incoming packets.
     uint32_t m_gradientCount;
     Address m_local;       //!< local multicast address
+    uint32_t m_aackBatchSize;     //!< Completed gradients acknowledged per AACK
+    Time m_aackDelay;             //!< Max time an AACK is held back (zero disables the timer)
+    std::map<std::string, std::set<uint32_t>> m_aackPending;  //!< Queued seqs per job
+    std::map<std::string, EventId> m_aackTimer;               //!< Delayed AACK event per job
+    std::map<std::string, LatencyTag> m_aackPath;             //!< Path stamps returned with the next AACK per job
+    uint16_t m_maxParts;          //!< Number of workers contributing to one gradient
+    uint16_t m_quorum;            //!< Parts a gradient completes with (zero waits for MaxParts)
+    LatePolicy m_latePolicy;      //!< What happens to the parts arriving after a quorum
+    std::map<std::string, std::map<uint16_t, uint32_t>> m_members;  //!< First seq of every member of elastic jobs
+    std::map<std::string, uint32_t> m_membershipEpoch;   //!< Last membership change applied per job
+    Time m_processingDelay;       //!< Aggregation time per received contribution
+    Time m_busyUntil;             //!< Time the aggregation engine becomes idle
+    std::deque<EventId> m_aggregateEvents;   //!< Contributions waiting for the aggregation engine, oldest first
+    uint16_t m_shardId;           //!< Index of this PS among the shards of a job
+    uint16_t m_numShards;         //!< Number of PS shards of a job
+    uint32_t m_shardSize;         //!< Consecutive seqs per shard range
+
+    AggregationDataType m_dataType; //!< Element type of the gradient values
+    ReduceOp m_reduceOp;          //!< Reduction applied to the gradient values
+    Ptr<Aggregator> m_aggregator; //!< Specialization for m_dataType and m_reduceOp
+    Ptr<EventTrace> m_eventTrace; //!< Binary event log (may be null)
+
+    /**
+     * Accumulator of one incomplete gradient.
+     */
+    struct Accumulator
+    {
+        std::set<uint16_t> parts;     //!< Contributors merged so far
+        std::vector<uint8_t> values;  //!< Aggregated values
+        double scale = 1.0;           //!< Fixed point scale of the values
+        uint16_t quorum = 0;          //!< Smallest quorum a switch completed it with (zero if none)
+    };
+
+    /**
+     * Aggregation state of one job.
+     */
+    struct JobState
+    {
+        std::map<uint32_t, Accumulator> accumulators;    //!< Accumulator per incomplete seq
+        std::map<uint32_t, std::vector<double>> ready;   //!< Decoded complete seqs waiting for their in-order update
+        uint32_t nextUpdate = 0;   //!< Next seq applied to the model
+        std::map<uint32_t, std::set<uint16_t>> late;    //!< Parts still due per seq completed with a quorum
+        std::vector<double> carry; //!< Late values folded into the next applied update
+    };
+
+    std::map<std::string, JobState> m_jobs;   //!< Aggregation state per job
     ////////////////////////////////
 
+    /// Callbacks for tracing model updates ( jobId, seq, values )
+    TracedCallback<uint16_t, uint32_t, const std::vector<double>&> m_updateTrace;
+
     /// Callbacks for tracing the packet Tx events
     TracedCallback<Ptr<const Packet>> m_txTrace;
 
@@ -0,0 +1,30 @@
+#ifndef PROTOCOL_MODE_H
+#define PROTOCOL_MODE_H
+
+namespace ns3
+{
+
+/**
+ * Aggregation protocol run by the workers and switches of a job.
+ */
+enum ProtocolMode
+{
+    PROTOCOL_PS,     //!< No in-network aggregation, the switch only relays gradients to the PS
+    PROTOCOL_ATP,    //!< Best effort switch aggregation, workers are paced by AACKs only
+    PROTOCOL_PA_ATP, //!< Switch aggregation with GACKs from the switch and AACKs from the PS
+    PROTOCOL_SWITCHML, //!< Fixed slot pool reused in lock step, results return from the switch
+};
+
+/**
+ * What happens to a contribution arriving after its gradient completed
+ * with a quorum of the parts.
+ */
+enum LatePolicy
+{
+    LATE_DROP, //!< Discard it, the PS rescales quorum results to the full part count
+    LATE_FOLD, //!< Add it to the next update the PS applies
+};
+
+} // namespace ns3
+
+#endif /* PROTOCOL_MODE_H */
@@ -0,0 +1,373 @@
+#include "ring_allreduce.h"
+
+#include "ns3/double.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/log.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/socket.h"
+#include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("RingAllReduceApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(RingAllReduce);
+
+TypeId
+RingAllReduce::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::RingAllReduce")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<RingAllReduce>()
+            .AddAttribute("Port",
+                          "Port the previous rank connects to",
+                          UintegerValue(9),
+                          MakeUintegerAccessor(&RingAllReduce::m_port),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("NextAddress",
+                          "Address of the next rank of the ring",
+                          AddressValue(),
+                          MakeAddressAccessor(&RingAllReduce::m_nextAddr),
+                          MakeAddressChecker())
+            .AddAttribute("Rank",
+                          "Position of this worker in the ring",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&RingAllReduce::m_rank),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("RingSize",
+                          "Number of ranks in the ring",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&RingAllReduce::m_ringSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("JobId",
+                          "Job the worker reports its metrics under",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&RingAllReduce::m_jobId),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("MaxPackets",
+                          "Packets of gradient reduced per iteration when no model profile is set",
+                          UintegerValue(100),
+                          MakeUintegerAccessor(&RingAllReduce::m_count),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("PacketSize",
+                          "Bytes of gradient per packet, and the largest write to the socket",
+                          UintegerValue(1024),
+                          MakeUintegerAccessor(&RingAllReduce::m_size),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Model",
+                          "Model profile the worker trains: ResNet-50, VGG-16, BERT-Base or GPT-2 "
+                          "(empty reduces MaxPackets * PacketSize bytes per iteration)",
+                          StringValue(""),
+                          MakeStringAccessor(&RingAllReduce::m_modelName),
+                          MakeStringChecker())
+            .AddAttribute("Iterations",
+                          "Training iterations to run",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&RingAllReduce::m_iterations),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("ComputeScale",
+                          "Factor applied to the compute times of the model profile",
+                          DoubleValue(1.0),
+                          MakeDoubleAccessor(&RingAllReduce::m_computeScale),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("Stats",
+                          "Metrics collector the worker reports to",
+                          PointerValue(),
+                          MakePointerAccessor(&RingAllReduce::m_stats),
+                          MakePointerChecker<JobStats>())
+            .AddTraceSource("Iteration",
+                            "An iteration has finished its last all-reduce",
+                            MakeTraceSourceAccessor(&RingAllReduce::m_iterationTrace),
+                            "ns3::RingAllReduce::IterationTracedCallback");
+    return tid;
+}
+
+RingAllReduce::RingAllReduce()
+{
+    NS_LOG_FUNCTION(this);
+    m_model = nullptr;
+    m_iteration = 0;
+    m_backwardDone = false;
+    m_connected = false;
+    m_txStep = 0;
+    m_rxStep = 0;
+    m_rxStepBytes = 0;
+    m_rxUnclaimed = 0;
+    m_txPending = 0;
+}
+
+RingAllReduce::~RingAllReduce()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+RingAllReduce::StartApplication()
+{
+    NS_LOG_FUNCTION(this);
+
+    NS_ABORT_MSG_IF(m_rank >= m_ringSize, "Rank " << m_rank << " is outside a ring of " << m_ringSize);
+    m_model = nullptr;
+    if (!m_modelName.empty()) {
+        m_model = GetModelProfile(m_modelName);
+        NS_ABORT_MSG_IF(!m_model, "Unknown model profile " << m_modelName);
+    }
+
+    if (m_ringSize > 1) {
+        TypeId tid = TypeId::LookupByName("ns3::TcpSocketFactory");
+        if (!m_listenSocket) {
+            m_listenSocket = Socket::CreateSocket(GetNode(), tid);
+            if (m_listenSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port)) == -1) {
+                NS_FATAL_ERROR("Failed to bind socket");
+            }
+            m_listenSocket->Listen();
+            m_listenSocket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                              MakeCallback(&RingAllReduce::HandleAccept, this));
+        }
+        if (!m_txSocket) {
+            NS_ABORT_MSG_IF(!Ipv4Address::IsMatchingType(m_nextAddr), "'NextAddress' attribute not properly set");
+            m_txSocket = Socket::CreateSocket(GetNode(), tid);
+            if (m_txSocket->Bind() == -1) {
+                NS_FATAL_ERROR("Failed to bind socket");
+            }
+            m_txSocket->SetConnectCallback(MakeCallback(&RingAllReduce::HandleConnect, this),
+                                           MakeCallback(&RingAllReduce::HandleConnectFail, this));
+            m_txSocket->SetSendCallback(MakeCallback(&RingAllReduce::HandleSend, this));
+            m_txSocket->Connect(InetSocketAddress(Ipv4Address::ConvertFrom(m_nextAddr), m_port));
+        }
+    }
+
+    m_iteration = 0;
+    StartIteration();
+}
+
+void
+RingAllReduce::StopApplication()
+{
+    NS_LOG_FUNCTION(this);
+
+    if (m_listenSocket) {
+        m_listenSocket->Close();
+        m_listenSocket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                          MakeNullCallback<void, Ptr<Socket>, const Address&>());
+        m_listenSocket = nullptr;
+    }
+    if (m_rxSocket) {
+        m_rxSocket->Close();
+        m_rxSocket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+        m_rxSocket = nullptr;
+    }
+    if (m_txSocket) {
+        m_txSocket->Close();
+        m_txSocket->SetSendCallback(MakeNullCallback<void, Ptr<Socket>, uint32_t>());
+        m_txSocket = nullptr;
+    }
+    m_connected = false;
+
+    Simulator::Cancel(m_computeEvent);
+}
+
+void
+RingAllReduce::HandleAccept(Ptr<Socket> socket, const Address& from)
+{
+    NS_LOG_FUNCTION(this << socket << from);
+    m_rxSocket = socket;
+    m_rxSocket->SetRecvCallback(MakeCallback(&RingAllReduce::HandleRead, this));
+}
+
+void
+RingAllReduce::HandleConnect(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    m_connected = true;
+    Flush();
+}
+
+void
+RingAllReduce::HandleConnectFail(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    NS_FATAL_ERROR("Rank " << m_rank << " cannot connect to the next rank, every rank must start at the same time");
+}
+
+void
+RingAllReduce::HandleRead(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    Ptr<Packet> packet;
+    while ((packet = socket->Recv()))
+    {
+        if (packet->GetSize() == 0)
+        {
+            break;
+        }
+        m_rxUnclaimed += packet->GetSize();
+    }
+    Advance();
+}
+
+void
+RingAllReduce::HandleSend(Ptr<Socket> socket, uint32_t available)
+{
+    NS_LOG_FUNCTION(this << socket << available);
+    Flush();
+}
+
+void
+RingAllReduce::StartIteration()
+{
+    NS_LOG_FUNCTION(this << m_iteration);
+    m_iterationStart = Simulator::Now();
+    m_backwardDone = false;
+    if (!m_model) {
+        m_backwardDone = true;
+        Enqueue(static_cast<uint64_t>(m_count) * m_size);
+        return;
+    }
+    // Backward starts from the output layer once the forward pass is done
+    uint32_t last = m_model->layers.size() - 1;
+    Time compute = m_model->forward + m_model->layers[last].backward;
+    m_computeEvent = Simulator::Schedule(compute * m_computeScale, &RingAllReduce::Backward, this, last);
+}
+
+void
+RingAllReduce::Backward(uint32_t layer)
+{
+    NS_LOG_FUNCTION(this << layer);
+    const LayerProfile& profile = m_model->layers[layer];
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " rank " << m_rank << " iteration " << m_iteration
+                << " released " << profile.name << " ( " << profile.bytes << " bytes )");
+    if (layer > 0) {
+        m_computeEvent = Simulator::Schedule(m_model->layers[layer - 1].backward * m_computeScale,
+                                             &RingAllReduce::Backward, this, layer - 1);
+    }
+    else {
+        m_backwardDone = true;
+    }
+    Enqueue(profile.bytes);
+}
+
+void
+RingAllReduce::Enqueue(uint64_t bytes)
+{
+    NS_LOG_FUNCTION(this << bytes);
+    m_buckets.push_back(Bucket{bytes, Simulator::Now()});
+    Advance();
+}
+
+uint64_t
+RingAllReduce::GetChunkSize(uint32_t rank, uint32_t step) const
+{
+    // Reduce-scatter and all-gather both send chunk ( rank - step ) mod N at a step
+    uint64_t bytes = m_buckets.front().bytes;
+    uint32_t chunk = (rank + m_ringSize - step % m_ringSize) % m_ringSize;
+    return bytes / m_ringSize + (chunk < bytes % m_ringSize ? 1 : 0);
+}
+
+void
+RingAllReduce::Advance()
+{
+    NS_LOG_FUNCTION(this);
+    const uint32_t steps = 2 * (m_ringSize - 1);
+    const uint32_t prev = (m_rank + m_ringSize - 1) % m_ringSize;
+    while (!m_buckets.empty())
+    {
+        // The byte stream of the previous rank is consumed step by step
+        while (m_rxStep < steps)
+        {
+            uint64_t need = GetChunkSize(prev, m_rxStep) - m_rxStepBytes;
+            uint64_t take = std::min(need, m_rxUnclaimed);
+            m_rxStepBytes += take;
+            m_rxUnclaimed -= take;
+            if (take < need)
+            {
+                break;
+            }
+            m_rxStep++;
+            m_rxStepBytes = 0;
+        }
+        // A step sends what the step before received
+        while (m_txStep < steps && m_txStep <= m_rxStep)
+        {
+            m_txPending += GetChunkSize(m_rank, m_txStep);
+            m_txStep++;
+        }
+        if (m_rxStep < steps)
+        {
+            break;
+        }
+
+        const Bucket& bucket = m_buckets.front();
+        NS_LOG_INFO(Simulator::Now().As(Time::S) << " rank " << m_rank << " reduced " << bucket.bytes
+                    << " bytes in " << (Simulator::Now() - bucket.released).As(Time::US));
+        if (m_stats)
+        {
+            m_stats->RecordAggregation(m_jobId, Simulator::Now() - bucket.released, bucket.bytes);
+        }
+        m_buckets.pop_front();
+        m_txStep = 0;
+        m_rxStep = 0;
+    }
+    Flush();
+    CheckIteration();
+}
+
+void
+RingAllReduce::Flush()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_connected)
+    {
+        return;
+    }
+    while (m_txPending > 0)
+    {
+        uint32_t size = std::min<uint64_t>({m_txPending, m_size, m_txSocket->GetTxAvailable()});
+        if (size == 0)
+        {
+            break;  // Resumed by HandleSend once the send buffer drains
+        }
+        int sent = m_txSocket->Send(Create<Packet>(size));
+        if (sent <= 0)
+        {
+            break;
+        }
+        m_txPending -= sent;
+        if (m_stats)
+        {
+            m_stats->RecordSend(m_jobId, sent);
+        }
+    }
+}
+
+void
+RingAllReduce::CheckIteration()
+{
+    if (!m_backwardDone || !m_buckets.empty())
+    {
+        return;
+    }
+    m_backwardDone = false;
+    Time duration = Simulator::Now() - m_iterationStart;
+    NS_LOG_INFO(Simulator::Now().As(Time::S) << " rank " << m_rank << " finished iteration " << m_iteration
+                << " in " << duration.As(Time::MS));
+    m_iterationTrace(m_iteration, duration);
+    if (++m_iteration < m_iterations)
+    {
+        StartIteration();
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,170 @@
+#ifndef RING_ALLREDUCE_H
+#define RING_ALLREDUCE_H
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/job_stats.h"
+#include "ns3/model_profile.h"
+
+#include <deque>
+
+namespace ns3
+{
+
+class Socket;
+class Packet;
+
+/**
+ * \ingroup applications
+ * \brief Host based ring all-reduce worker
+ *
+ * Baseline to compare in network aggregation against. Every rank streams
+ * to the next rank of the ring over TCP and receives from the previous
+ * one. A tensor is cut into one chunk per rank and reduced in 2 * (N - 1)
+ * steps, N - 1 of reduce-scatter followed by N - 1 of all-gather. The
+ * chunk a rank sends at a step is the one it received at the step before,
+ * so a step only starts once the previous one is received.
+ *
+ * Tensors come from the same workloads as CustomClient : a model profile
+ * releases one bucket per layer during the backward pass, otherwise every
+ * iteration reduces MaxPackets * PacketSize bytes. Buckets are reduced one
+ * at a time in release order, and an iteration ends when its last bucket
+ * is reduced.
+ */
+class RingAllReduce : public Application
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    RingAllReduce();
+
+    ~RingAllReduce() override;
+
+    /**
+     * TracedCallback signature for completed iterations.
+     *
+     * \param [in] iteration iteration index
+     * \param [in] duration time from the start of the forward pass to the
+     *             end of the last all-reduce of the iteration
+     */
+    typedef void (*IterationTracedCallback)(uint32_t iteration, Time duration);
+
+  private:
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /**
+     * \brief Handle a connection request of the previous rank.
+     * \param socket the accepted socket
+     * \param from address of the previous rank
+     */
+    void HandleAccept(Ptr<Socket> socket, const Address& from);
+    /**
+     * \brief Handle the connection to the next rank being established.
+     * \param socket the connected socket
+     */
+    void HandleConnect(Ptr<Socket> socket);
+    /**
+     * \brief Handle a failed connection to the next rank.
+     * \param socket the socket
+     */
+    void HandleConnectFail(Ptr<Socket> socket);
+    /**
+     * \brief Handle a packet reception from the previous rank.
+     * \param socket the socket the packet was received to.
+     */
+    void HandleRead(Ptr<Socket> socket);
+    /**
+     * \brief Handle free space in the send buffer.
+     * \param socket the socket
+     * \param available free bytes in the send buffer
+     */
+    void HandleSend(Ptr<Socket> socket, uint32_t available);
+
+    /**
+     * \brief Start the forward pass of the next iteration
+     */
+    void StartIteration();
+    /**
+     * \brief Finish the backward compute of a layer and release its gradient
+     * \param layer layer index in the model profile
+     */
+    void Backward(uint32_t layer);
+    /**
+     * \brief Queue a tensor for all-reduce
+     * \param bytes tensor size
+     */
+    void Enqueue(uint64_t bytes);
+    /**
+     * \brief Get the size of the chunk sent or received at a step
+     * \param rank rank sending the chunk
+     * \param step step of the all-reduce
+     * \return the chunk size in bytes
+     */
+    uint64_t GetChunkSize(uint32_t rank, uint32_t step) const;
+    /**
+     * \brief Start every step the received data allows and finish the
+     *        buckets whose last step is received
+     */
+    void Advance();
+    /**
+     * \brief Hand queued bytes to the socket while its send buffer has room
+     */
+    void Flush();
+    /**
+     * \brief Finish the iteration once every bucket of it is reduced
+     */
+    void CheckIteration();
+
+    /**
+     * A tensor waiting for or under all-reduce.
+     */
+    struct Bucket
+    {
+        uint64_t bytes;   //!< Tensor size
+        Time released;    //!< Time the tensor was released
+    };
+
+    uint16_t m_port;              //!< Port the previous rank connects to
+    Address m_nextAddr;           //!< Address of the next rank
+    uint32_t m_rank;              //!< Position of this worker in the ring
+    uint32_t m_ringSize;          //!< Number of ranks in the ring
+    uint16_t m_jobId;             //!< Job the worker belongs to
+    uint32_t m_count;             //!< Packets per iteration without a model profile
+    uint32_t m_size;              //!< Bytes per packet
+    std::string m_modelName;      //!< Model profile the worker trains (empty disables it)
+    const ModelProfile* m_model;  //!< Profile of m_modelName
+    uint32_t m_iterations;        //!< Training iterations to run
+    uint32_t m_iteration;         //!< Current iteration
+    double m_computeScale;        //!< Factor applied to the profile compute times
+    bool m_backwardDone;          //!< Whether every bucket of the iteration is released
+    Time m_iterationStart;        //!< Start of the current iteration
+    Ptr<JobStats> m_stats;        //!< Metrics collector (may be null)
+
+    Ptr<Socket> m_listenSocket;   //!< Listening socket for the previous rank
+    Ptr<Socket> m_rxSocket;       //!< Accepted socket of the previous rank
+    Ptr<Socket> m_txSocket;       //!< Socket to the next rank
+    bool m_connected;             //!< Whether m_txSocket is connected
+
+    std::deque<Bucket> m_buckets; //!< Released tensors, the front one is under all-reduce
+    uint32_t m_txStep;            //!< Next step of the front bucket to send
+    uint32_t m_rxStep;            //!< Next step of the front bucket to receive
+    uint64_t m_rxStepBytes;       //!< Bytes received of m_rxStep so far
+    uint64_t m_rxUnclaimed;       //!< Bytes received ahead of their bucket release
+    uint64_t m_txPending;         //!< Bytes of started steps not handed to the socket yet
+    EventId m_computeEvent;       //!< Forward or backward compute of the current iteration
+
+    /// Callbacks for tracing completed iterations
+    TracedCallback<uint32_t, Time> m_iterationTrace;
+};
+
+} // namespace ns3
+
+#endif /* RING_ALLREDUCE_H */
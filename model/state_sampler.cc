@@ -0,0 +1,161 @@
+#include "state_sampler.h"
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/enum.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("StateSampler");
+
+NS_OBJECT_ENSURE_REGISTERED(StateSampler);
+
+TypeId
+StateSampler::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::StateSampler")
+            .SetParent<Object>()
+            .SetGroupName("Applications")
+            .AddConstructor<StateSampler>()
+            .AddAttribute("Interval",
+                          "Time between two rows",
+                          TimeValue(MilliSeconds(1)),
+                          MakeTimeAccessor(&StateSampler::m_interval),
+                          MakeTimeChecker())
+            .AddAttribute("FileName",
+                          "File the time series is written to",
+                          StringValue("state.csv"),
+                          MakeStringAccessor(&StateSampler::m_fileName),
+                          MakeStringChecker())
+            .AddAttribute("Format",
+                          "Format of the time series file",
+                          EnumValue(CSV),
+                          MakeEnumAccessor<Format>(&StateSampler::m_format),
+                          MakeEnumChecker(CSV, "Csv",
+                                          BINARY, "Binary"));
+    return tid;
+}
+
+StateSampler::StateSampler()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+StateSampler::~StateSampler()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+StateSampler::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Simulator::Cancel(m_sampleEvent);
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+    Object::DoDispose();
+}
+
+bool
+StateSampler::AddColumn(std::string name, Ptr<Object> object, std::string traceSource)
+{
+    NS_LOG_FUNCTION(this << name << object << traceSource);
+    NS_ABORT_MSG_IF(m_file.is_open(), "Columns must be added before sampling starts");
+    uint32_t column = m_names.size();
+    if (!object->TraceConnectWithoutContext(traceSource, MakeBoundCallback(&StateSampler::Trace, this, column)))
+    {
+        NS_LOG_WARN("No trace source " << traceSource << " for column " << name);
+        return false;
+    }
+    m_names.push_back(name);
+    m_values.push_back(0);
+    return true;
+}
+
+void
+StateSampler::Trace(StateSampler* sampler, uint32_t column, uint32_t oldValue, uint32_t newValue)
+{
+    sampler->m_values[column] = newValue;
+}
+
+void
+StateSampler::Start(Time start)
+{
+    NS_LOG_FUNCTION(this << start);
+    Simulator::Cancel(m_sampleEvent);
+    m_sampleEvent = Simulator::Schedule(start, &StateSampler::Sample, this);
+}
+
+void
+StateSampler::Stop(Time stop)
+{
+    NS_LOG_FUNCTION(this << stop);
+    m_stop = stop;
+}
+
+void
+StateSampler::Open()
+{
+    m_file.open(m_fileName, m_format == BINARY ? std::ios::out | std::ios::binary : std::ios::out);
+    NS_ABORT_MSG_IF(!m_file, "Cannot open " << m_fileName);
+    if (m_format == CSV)
+    {
+        m_file << "time_s";
+        for (const std::string& name : m_names)
+        {
+            m_file << ',' << name;
+        }
+        m_file << '\n';
+        return;
+    }
+    uint32_t columns = m_names.size();
+    m_file.write("PATS", 4);
+    m_file.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+    for (const std::string& name : m_names)
+    {
+        uint16_t length = name.size();
+        m_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_file.write(name.data(), length);
+    }
+}
+
+void
+StateSampler::Sample()
+{
+    if (!m_file.is_open())
+    {
+        Open();
+    }
+    if (m_format == CSV)
+    {
+        m_file << Simulator::Now().GetSeconds();
+        for (uint32_t value : m_values)
+        {
+            m_file << ',' << value;
+        }
+        m_file << '\n';
+    }
+    else
+    {
+        int64_t now = Simulator::Now().GetNanoSeconds();
+        m_file.write(reinterpret_cast<const char*>(&now), sizeof(now));
+        m_file.write(reinterpret_cast<const char*>(m_values.data()), m_values.size() * sizeof(uint32_t));
+    }
+    if (Simulator::Now() + m_interval <= m_stop)
+    {
+        m_sampleEvent = Simulator::Schedule(m_interval, &StateSampler::Sample, this);
+    }
+    else
+    {
+        m_file.flush();
+    }
+}
+
+} // namespace ns3
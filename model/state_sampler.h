@@ -0,0 +1,106 @@
+#ifndef STATE_SAMPLER_H
+#define STATE_SAMPLER_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \ingroup applications
+ * \brief Samples uint32_t TracedValue sources into a time series file.
+ *
+ * Every column follows one trace source and holds its latest value. A row
+ * with all columns is written every Interval between Start and Stop.
+ *
+ * The CSV format has a "time_s" column followed by one column per source.
+ * The binary format starts with the magic "PATS", a uint32_t column count
+ * and the column names, each a uint16_t length and the characters. Every
+ * row is then an int64_t time in ns followed by one uint32_t per column,
+ * all in host byte order.
+ */
+class StateSampler : public Object
+{
+  public:
+    /// Output file format
+    enum Format
+    {
+        CSV,
+        BINARY,
+    };
+
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    StateSampler();
+
+    ~StateSampler() override;
+
+    /**
+     * \brief Add a column following a TracedValue<uint32_t> source.
+     * \param name column name
+     * \param object object owning the trace source
+     * \param traceSource name of the trace source
+     * \return true if the trace source was connected
+     */
+    bool AddColumn(std::string name, Ptr<Object> object, std::string traceSource);
+
+    /**
+     * \brief Start writing rows.
+     * \param start delay of the first row from now
+     */
+    void Start(Time start);
+
+    /**
+     * \brief Set the time of the last row. Rows are not rescheduled past it,
+     * so the sampler never keeps the simulation running on its own.
+     * \param stop time of the last row
+     */
+    void Stop(Time stop);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * \brief Store the new value of a column.
+     * \param sampler the sampler the column belongs to
+     * \param column column index
+     * \param oldValue previous value
+     * \param newValue current value
+     */
+    static void Trace(StateSampler* sampler, uint32_t column, uint32_t oldValue, uint32_t newValue);
+
+    /**
+     * \brief Open the file and write the header.
+     */
+    void Open();
+
+    /**
+     * \brief Write a row and schedule the next one.
+     */
+    void Sample();
+
+    Time m_interval;                   //!< Time between rows
+    std::string m_fileName;            //!< Output file
+    Format m_format;                   //!< Output file format
+    Time m_stop;                       //!< Time of the last row
+    EventId m_sampleEvent;             //!< Next row
+    std::ofstream m_file;              //!< Output stream
+    std::vector<std::string> m_names;  //!< Column names
+    std::vector<uint32_t> m_values;    //!< Latest value per column
+};
+
+} // namespace ns3
+
+#endif /* STATE_SAMPLER_H */
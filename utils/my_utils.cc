@@ -18,4 +18,63 @@ vector<string> split_string (string input, char *delim) {
         pch = strtok(NULL, delim);
     }
     return output;
-}
\ No newline at end of file
+}
+
+string encode_bitmap (const set<uint16_t> &bits) {
+    if (bits.empty()) {
+        return "0";
+    }
+    const char *digits = "0123456789abcdef";
+    uint32_t nibbles = *bits.rbegin() / 4 + 1;
+    string output(nibbles, '0');
+    for (uint16_t bit : bits) {
+        char &c = output[nibbles - 1 - bit / 4];
+        c = digits[(strchr(digits, c) - digits) | (1 << (bit % 4))];
+    }
+    return output;
+}
+
+set<uint16_t> decode_bitmap (const string &hex) {
+    set<uint16_t> output;
+    uint32_t nibbles = hex.size();
+    for (uint32_t i = 0; i < nibbles; i++) {
+        char c = hex[nibbles - 1 - i];
+        uint8_t value = (c >= 'a') ? c - 'a' + 10 : (c >= 'A') ? c - 'A' + 10 : c - '0';
+        for (uint8_t b = 0; b < 4; b++) {
+            if (value & (1 << b)) {
+                output.insert(i * 4 + b);
+            }
+        }
+    }
+    return output;
+}
+
+string encode_ranges (const set<uint32_t> &seqs) {
+    string output;
+    auto it = seqs.begin();
+    while (it != seqs.end()) {
+        uint32_t first = *it;
+        uint32_t last = first;
+        while (++it != seqs.end() && *it == last + 1) {
+            last = *it;
+        }
+        if (!output.empty()) {
+            output += ',';
+        }
+        output += to_string(first);
+        if (last != first) {
+            output += '-' + to_string(last);
+        }
+    }
+    return output;
+}
+
+void decode_range (const string &field, set<uint32_t> &output) {
+    size_t dash = field.find('-');
+    uint32_t first = stoul(field.substr(0, dash));
+    uint32_t last = (dash == string::npos) ? first : stoul(field.substr(dash + 1));
+    // 64 bit counter, a range ending at UINT32_MAX would wrap around
+    for (uint64_t seq = first; seq <= last; seq++) {
+        output.insert(seq);
+    }
+}
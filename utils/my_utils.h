@@ -2,7 +2,17 @@
 
 #include <vector>
 #include <string>
+#include <set>
+#include <stdint.h>
 
 using namespace std;
 
-vector<string> split_string (string input, char *delim);
\ No newline at end of file
+vector<string> split_string (string input, char *delim);
+
+// Hex encoding of a bitmap, bit i set for every i in bits ("0" when empty)
+string encode_bitmap (const set<uint16_t> &bits);
+set<uint16_t> decode_bitmap (const string &hex);
+
+// Comma separated seq ranges ("0-4,7,9-10") and the decoding of one range field
+string encode_ranges (const set<uint32_t> &seqs);
+void decode_range (const string &field, set<uint32_t> &output);